@@ -1,5 +1,6 @@
 
 // std
+#include <chrono>
 #include <iostream>
 #include <string>
 
@@ -10,6 +11,7 @@
 
 // project
 #include "application.hpp"
+#include "profiler.hpp"
 #include "cgra/cgra_gui.hpp"
 #include "cgra/cgra_shader.hpp"
 
@@ -19,8 +21,70 @@ using namespace cgra;
 
 
 Application::Application() {
-	// set time
-	m_current_time = chrono::steady_clock::now();
+	Profiler::setThreadName("main");
+
+	// start the simulation last, once everything it touches exists
+	m_sim_thread = thread(&Application::simulate, this);
+}
+
+
+Application::~Application() {
+	m_sim_running = false;
+	m_sim_thread.join();
+}
+
+
+void Application::simulate() {
+	Profiler::setThreadName("simulation");
+
+	chrono::time_point<chrono::steady_clock> last = chrono::steady_clock::now();
+	chrono::time_point<chrono::steady_clock> rate_start = last;
+	int rate_steps = 0;
+
+	while (m_sim_running) {
+		chrono::time_point<chrono::steady_clock> now = chrono::steady_clock::now();
+		double time_delta = (now - last) / 1.0s; // in seconds
+		last = now;
+
+		bool loaded = m_scene.syncSettings();
+
+		// work out what to run while holding the lock, but step without it
+		int steps = 0;
+		float timestep, interval, wait;
+		{
+			lock_guard<mutex> lock(m_clock_mutex);
+			if (!m_pause) {
+				// run whole fixed steps, the remainder carries over to the next pass
+				steps = m_clock.advance(float(time_delta) * m_timescale);
+			}
+			timestep = m_clock.timestep();
+
+			// wall clock time per step, and until the next one is due
+			float scale = (m_pause || m_timescale <= 0) ? 0 : m_timescale;
+			interval = scale > 0 ? timestep / scale : 0;
+			wait = scale > 0 ? m_clock.untilNextStep() / scale : 0.01f;
+		}
+
+		for (int i = 0; i < steps; i++)
+			m_scene.simulation().update(timestep);
+
+		if (steps > 0 || loaded) {
+			m_scene.publishSnapshot(interval);
+		}
+		else {
+			// nothing due yet, don't spin
+			this_thread::sleep_for(chrono::duration<float>(glm::min(wait, 0.01f)));
+		}
+
+		// measured step rate, refreshed every half second
+		rate_steps += steps;
+		double rate_time = (now - rate_start) / 1.0s;
+		if (rate_time >= 0.5) {
+			m_sim_rate = float(rate_steps / rate_time);
+			rate_steps = 0;
+			rate_start = now;
+		}
+	}
 }
 
 
@@ -72,16 +136,8 @@ void Application::charCallback(unsigned int c) {
 
 
 void Application::render(int width, int height) {
-	
-	// Update
 
-	chrono::time_point<chrono::steady_clock> now = chrono::steady_clock::now();
-	double time_delta = (now - m_current_time) / 1.0s; // in seconds
-	m_current_time = now;
-	if (!m_pause)
-		m_scene.update(float(time_delta) * m_timescale);
-
-	// Draw
+	// Draw (the simulation runs on its own thread, see simulate)
 
 	// record current draw size
 	m_viewport_size = glm::vec2(width, height);
@@ -125,8 +181,33 @@ void Application::renderGUI() {
 		ImGui::TreePop();
 	}
 
+	// time per phase of the simulation step and of drawing
+	if (ImGui::TreeNode("Profiler")) {
+		bool enabled = Profiler::enabled();
+		if (ImGui::Checkbox("Enabled", &enabled)) Profiler::setEnabled(enabled);
+
+		ImGui::Text("Average over the last second (ms)");
+		string thread;
+		for (const ProfileSummary &s : Profiler::summarize(1000)) {
+			if (s.thread != thread) {
+				thread = s.thread;
+				ImGui::Text("%s", thread.c_str());
+			}
+			ImGui::Text("  %-12s %8.3f  (last %.3f, %d/s)", s.name, s.meanMs, s.lastMs, s.count);
+		}
+
+		if (ImGui::Button("Save Chrome trace", ImVec2(150, 0))) {
+			m_trace_status = Profiler::writeChromeTrace("trace.json") ? "Saved trace.json" : "Could not write trace.json";
+		}
+		ImGui::SameLine();
+		ImGui::Text("%s", m_trace_status.c_str());
+
+		ImGui::TreePop();
+	}
+
 	// simulation parameters
 	if (ImGui::TreeNode("Simulation")) {
+		lock_guard<mutex> lock(m_clock_mutex);
 		ImGui::SliderFloat("Timescale", &m_timescale, 0.0, 100.0, "%.2f", 3.0f);
 		if (ImGui::Button("Reset", ImVec2(100, 0))) m_timescale = 1.0;
 		ImGui::SameLine();
@@ -139,6 +220,15 @@ void Application::renderGUI() {
 				m_pause = true;
 		}
 
+		// fixed step rate, independent of the display rate
+		float rate = m_clock.rate();
+		if (ImGui::SliderFloat("Steps/second", &rate, 10, 240, "%.0f"))
+			m_clock.setRate(rate);
+		int substeps = m_clock.maxSubsteps();
+		if (ImGui::SliderInt("Max steps/pass", &substeps, 1, 32))
+			m_clock.setMaxSubsteps(substeps);
+		ImGui::Text("Simulation %.1f steps/s (%d last pass)", m_sim_rate.load(), m_clock.lastSteps());
+
 		ImGui::TreePop();
 	}
 
@@ -2,7 +2,10 @@
 #pragma once
 
 // std
-#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
 
 // glm
 #include <glm.hpp>
@@ -11,6 +14,7 @@
 #include "boid.hpp"
 #include "opengl.hpp"
 #include "scene.hpp"
+#include "sim_clock.hpp"
 #include "cgra/cgra_mesh.hpp"
 
 // main application class
@@ -30,14 +34,25 @@ private:
 	// scene
 	Scene m_scene;
 
-	// time keeping
+	// time keeping (guarded by m_clock_mutex, shared with the simulation thread)
 	float m_timescale = 1.0;
 	bool m_pause = false;
-	std::chrono::time_point<std::chrono::steady_clock> m_current_time;
+	SimClock m_clock;
+	std::mutex m_clock_mutex;
+
+	// simulation thread, steps the scene and publishes snapshots for drawing
+	std::thread m_sim_thread;
+	std::atomic<bool> m_sim_running{ true };
+	std::atomic<float> m_sim_rate{ 0 };	// measured steps per (wall clock) second
+	void simulate();
+
+	// result of the last Chrome trace save
+	std::string m_trace_status;
 
 public:
 	// setup
 	Application();
+	~Application();
 
 	// disable copy constructors (for safety)
 	Application(const Application&) = delete;
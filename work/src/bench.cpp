@@ -0,0 +1,393 @@
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// glm
+#include <gtc/constants.hpp>
+
+// project
+#include "boid_random.hpp"
+#include "cpu_features.hpp"
+#include "profiler.hpp"
+#include "simulation.hpp"
+
+
+using namespace std;
+
+
+namespace {
+
+	// phases of Simulation::update, timed separately
+	const char *phase_names[] = { "build", "field", "forces", "bounds", "integrate", "commit", "total" };
+	const int num_phases = 7;
+
+	struct Options {
+		vector<string> scenarios = { "uniform", "packed", "completion", "expanding", "evade" };
+		vector<int> sizes = { 1000, 10000, 100000, 1000000 };
+		vector<int> predators = { 1, 10, 100, 1000 };	// predator counts for the evade scenario
+		vector<float> radii = { 1 };
+		vector<float> neighbours = { 16 };	// expected boids inside the sight radius (density)
+		int reps = 5;
+		int warmup = 2;
+		int steps = 5;
+		int denseMax = 20000;	// largest N for the scenarios that are quadratic in N
+		float skin = 0;			// neighbour list skin, 0 turns the lists off
+		int reorder = 0;		// steps between Morton reorders, 0 for never
+		float theta = 0;		// Barnes-Hut opening angle, 0 turns the tree off
+		int knn = 0;			// nearest neighbours to flock with, 0 for radius flocking
+		unsigned seed = 1;
+		string json;
+	};
+
+	// one configuration of the sweep
+	struct Config {
+		string scenario;
+		int n;
+		float radius;
+		float neighbours;
+		int predators;		// on top of the n boids (evade only)
+	};
+
+	struct Stats {
+		double mean = 0, stddev = 0, min = 0, median = 0;
+	};
+
+	struct Result {
+		Config config;
+		size_t boidsEnd = 0;
+		Stats phases[num_phases];
+	};
+
+	void printUsage(const char *exe) {
+		cerr << "Usage: " << exe << " [options]" << endl
+			<< "  --scenarios A,B   uniform, packed, completion, expanding, evade (default all)" << endl
+			<< "  --sizes N,M       boid counts to sweep (default 1000,10000,100000,1000000)" << endl
+			<< "  --predators P,Q   predator counts to sweep for evade (default 1,10,100,1000)" << endl
+			<< "  --radii R,S       sight radii to sweep (default 1)" << endl
+			<< "  --neighbours K,L  expected boids within the sight radius (default 16)" << endl
+			<< "  --reps N          repetitions per configuration (default 5)" << endl
+			<< "  --warmup N        untimed steps before each repetition (default 2)" << endl
+			<< "  --steps N         timed steps per repetition (default 5)" << endl
+			<< "  --dense-max N     largest N for packed, completion and expanding (default 20000)" << endl
+			<< "  --skin S          neighbour list skin, 0 for no lists (default 0)" << endl
+			<< "  --reorder N       Morton reorder every N steps, 0 for never (default 0)" << endl
+			<< "  --theta T         Barnes-Hut flocking with opening angle T, 0 for off (default 0)" << endl
+			<< "  --knn K           flock with the K nearest boids, 0 for radius flocking (default 0)" << endl
+			<< "  --simd LEVEL      kernel instruction set: scalar, sse2, avx2 or avx512" << endl
+			<< "                    (default the best the CPU supports)" << endl
+			<< "  --seed S          layout seed (default 1)" << endl
+			<< "  --json FILE       write the results as JSON (- for stdout)" << endl;
+	}
+
+	template <typename T>
+	vector<T> parseList(const string &s) {
+		vector<T> out;
+		stringstream ss(s);
+		string item;
+		while (getline(ss, item, ',')) {
+			if (item.empty()) continue;
+			stringstream is(item);
+			T value;
+			is >> value;
+			out.push_back(value);
+		}
+		return out;
+	}
+
+	Stats summarize(vector<double> v) {
+		Stats s;
+		if (v.empty()) return s;
+		sort(v.begin(), v.end());
+		for (double x : v) s.mean += x;
+		s.mean /= v.size();
+		for (double x : v) s.stddev += (x - s.mean) * (x - s.mean);
+		s.stddev = v.size() > 1 ? sqrt(s.stddev / (v.size() - 1)) : 0;
+		s.min = v.front();
+		s.median = (v.size() % 2) ? v[v.size() / 2] : (v[v.size() / 2 - 1] + v[v.size() / 2]) / 2;
+		return s;
+	}
+
+	// the quadratic scenarios put (nearly) every boid in every neighbourhood
+	bool isDense(const string &scenario) {
+		return scenario == "packed" || scenario == "completion" || scenario == "expanding";
+	}
+
+	// settings with every sight distance set to radius
+	SceneSettings makeSettings(const Config &c, const Options &opt) {
+		SceneSettings settings;
+		settings.neighbourLists = opt.skin > 0;
+		settings.neighbourSkin = opt.skin;
+		settings.reorderInterval = opt.reorder;
+		settings.flockTree = opt.theta > 0;
+		settings.treeTheta = opt.theta;
+		settings.topologicalNeighbours = opt.knn;
+		settings.predatorField = c.scenario == "evade";
+		for (FlockParams &p : settings.params) {
+			p.cohesionDist = c.radius;
+			p.avoidDist = c.radius;
+			p.alignmentDist = c.radius;
+		}
+
+		// box sized so a sight sphere holds the requested number of boids on average
+		float sphere = 4.0f / 3.0f * glm::pi<float>() * c.radius * c.radius * c.radius;
+		float volume = c.n * sphere / glm::max(c.neighbours, 1e-3f);
+		settings.bound = glm::vec3(0.5f * cbrt(volume));
+		settings.deterministic = true;
+		settings.seed = opt.seed;
+		return settings;
+	}
+
+	// fills the simulation with the layout for the configuration
+	void load(Simulation &sim, const Config &c, const Options &opt) {
+		unsigned seed = opt.seed;
+		SceneSettings settings = makeSettings(c, opt);
+		if (c.scenario == "packed") {
+			// a box no bigger than one grid cell, so every boid shares it
+			settings.bound = glm::vec3(c.radius * 0.5f);
+		}
+		sim.setSettings(settings);
+
+		if (c.scenario == "completion") {
+			// two flocks plus predators, spawned like Scene's completion load
+			sim.setNumBoids(c.n / 2);
+			sim.setNumPredators(glm::max(c.n / 1000, 1));
+			sim.loadCompletion();
+			return;
+		}
+
+		BoidStore &boids = sim.boids();
+		boids.clear();
+		boids.reserve(c.n);
+		glm::vec3 hsize = sim.bound();
+		for (int i = 0; i < c.n; i++) {
+			BoidRandom rand(seed, i);
+			glm::vec3 pos = rand.linearRand(-hsize, hsize);
+			glm::vec3 vel = rand.sphericalRand(10.0f);
+			boids.push_back(pos, vel, i % 2, glm::vec3(0, 1, 0), 0);
+		}
+
+		// uniform prey evading predators spread over the box
+		for (int i = 0; i < c.predators; i++) {
+			BoidRandom rand(seed, c.n + i);
+			boids.push_back(rand.linearRand(-hsize, hsize), rand.sphericalRand(10.0f), -1, glm::vec3(1, 0, 0), 1);
+		}
+	}
+
+	// runs one repetition and returns the ns/boid of every phase
+	vector<double> runOnce(Simulation &sim, const Config &c, const Options &opt) {
+		typedef chrono::steady_clock clock;
+		const float timestep = 1.0f / 60.0f;
+		load(sim, c, opt);
+
+		for (int s = 0; s < opt.warmup; s++) sim.update(timestep);
+
+		double ns[num_phases] = { 0 };
+		double boidSteps = 0;
+		for (int s = 0; s < opt.steps; s++) {
+			if (c.scenario == "expanding") {
+				// boids that lost their flock search with the widened avoid distance
+				for (Boid &b : sim.boids().cold()) b.setExpandingSight(true);
+			}
+			boidSteps += double(sim.boids().size());
+
+			clock::time_point t0 = clock::now();
+			sim.beginStep();
+			clock::time_point t1 = clock::now();
+			sim.buildField();
+			clock::time_point t2 = clock::now();
+			sim.calculateForces();
+			clock::time_point t3 = clock::now();
+			sim.applyBounds();
+			clock::time_point t4 = clock::now();
+			sim.integrate(timestep);
+			clock::time_point t5 = clock::now();
+			sim.commit();
+			clock::time_point t6 = clock::now();
+
+			ns[0] += chrono::duration<double, nano>(t1 - t0).count();
+			ns[1] += chrono::duration<double, nano>(t2 - t1).count();
+			ns[2] += chrono::duration<double, nano>(t3 - t2).count();
+			ns[3] += chrono::duration<double, nano>(t4 - t3).count();
+			ns[4] += chrono::duration<double, nano>(t5 - t4).count();
+			ns[5] += chrono::duration<double, nano>(t6 - t5).count();
+			ns[6] += chrono::duration<double, nano>(t6 - t0).count();
+		}
+
+		vector<double> perBoid(num_phases);
+		for (int p = 0; p < num_phases; p++) perBoid[p] = boidSteps > 0 ? ns[p] / boidSteps : 0;
+		return perBoid;
+	}
+
+	void writeJson(ostream &out, const vector<Result> &results, const Options &opt, int threads) {
+		out << "{" << endl;
+		out << "\t\"benchmark\": \"boids_bench\"," << endl;
+		out << "\t\"unit\": \"ns/boid\"," << endl;
+		out << "\t\"threads\": " << threads << "," << endl;
+		out << "\t\"reps\": " << opt.reps << "," << endl;
+		out << "\t\"warmup\": " << opt.warmup << "," << endl;
+		out << "\t\"steps\": " << opt.steps << "," << endl;
+		out << "\t\"seed\": " << opt.seed << "," << endl;
+		out << "\t\"skin\": " << opt.skin << "," << endl;
+		out << "\t\"reorder\": " << opt.reorder << "," << endl;
+		out << "\t\"theta\": " << opt.theta << "," << endl;
+		out << "\t\"knn\": " << opt.knn << "," << endl;
+		out << "\t\"simd\": \"" << simdLevelName(simdLevel()) << "\"," << endl;
+		out << "\t\"results\": [" << endl;
+		for (size_t r = 0; r < results.size(); r++) {
+			const Result &res = results[r];
+			out << "\t\t{ \"scenario\": \"" << res.config.scenario << "\""
+				<< ", \"n\": " << res.config.n
+				<< ", \"radius\": " << res.config.radius
+				<< ", \"neighbours\": " << res.config.neighbours
+				<< ", \"predators\": " << res.config.predators
+				<< ", \"boids_end\": " << res.boidsEnd
+				<< ", \"phases\": {";
+			for (int p = 0; p < num_phases; p++) {
+				const Stats &s = res.phases[p];
+				out << (p ? ", " : " ") << "\"" << phase_names[p] << "\": { "
+					<< "\"mean\": " << s.mean << ", \"stddev\": " << s.stddev
+					<< ", \"min\": " << s.min << ", \"median\": " << s.median << " }";
+			}
+			out << " } }" << (r + 1 < results.size() ? "," : "") << endl;
+		}
+		out << "\t]" << endl;
+		out << "}" << endl;
+	}
+}
+
+
+// Benchmark suite for the flocking step. Sweeps the scenarios over boid
+// count, sight radius and density, and reports the ns/boid of every phase
+// of Simulation::update over repeated runs.
+//
+int main(int argc, char **argv) {
+	Options opt;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--help" || arg == "-h") {
+			printUsage(argv[0]);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			cerr << "Error: missing value for " << arg << endl;
+			printUsage(argv[0]);
+			return 1;
+		}
+		string value = argv[++i];
+
+		if (arg == "--scenarios") opt.scenarios = parseList<string>(value);
+		else if (arg == "--sizes") opt.sizes = parseList<int>(value);
+		else if (arg == "--predators") opt.predators = parseList<int>(value);
+		else if (arg == "--radii") opt.radii = parseList<float>(value);
+		else if (arg == "--neighbours") opt.neighbours = parseList<float>(value);
+		else if (arg == "--reps") opt.reps = glm::max(atoi(value.c_str()), 1);
+		else if (arg == "--warmup") opt.warmup = glm::max(atoi(value.c_str()), 0);
+		else if (arg == "--steps") opt.steps = glm::max(atoi(value.c_str()), 1);
+		else if (arg == "--dense-max") opt.denseMax = atoi(value.c_str());
+		else if (arg == "--skin") opt.skin = float(atof(value.c_str()));
+		else if (arg == "--reorder") opt.reorder = atoi(value.c_str());
+		else if (arg == "--theta") opt.theta = float(atof(value.c_str()));
+		else if (arg == "--knn") opt.knn = atoi(value.c_str());
+		else if (arg == "--simd") {
+			SimdLevel level;
+			if (!parseSimdLevel(value, level)) {
+				cerr << "Error: unknown instruction set " << value << endl;
+				printUsage(argv[0]);
+				return 1;
+			}
+			if (setSimdLevel(level) != level) {
+				cerr << "Warning: " << value << " is not supported here, using " << simdLevelName(simdLevel()) << endl;
+			}
+		}
+		else if (arg == "--seed") opt.seed = unsigned(strtoul(value.c_str(), nullptr, 10));
+		else if (arg == "--json") opt.json = value;
+		else {
+			cerr << "Error: unknown option " << arg << endl;
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	for (const string &s : opt.scenarios) {
+		if (s != "uniform" && s != "packed" && s != "completion" && s != "expanding" && s != "evade") {
+			cerr << "Error: unknown scenario " << s << endl;
+			return 1;
+		}
+	}
+
+	// we time the phases ourselves
+	Profiler::setEnabled(false);
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	// the table goes to stderr when the JSON goes to stdout
+	ostream &log = (opt.json == "-") ? cerr : cout;
+	log << "boids_bench: " << threads << " threads, " << simdLevelName(simdLevel())
+		<< " kernels, " << opt.reps << " reps x "
+		<< opt.steps << " steps (ns/boid, mean +- stddev)" << endl;
+
+	vector<Result> results;
+	for (const string &scenario : opt.scenarios) {
+		for (int n : opt.sizes) {
+			if (isDense(scenario) && n > opt.denseMax) {
+				log << scenario << " n=" << n << ": skipped (over --dense-max)" << endl;
+				continue;
+			}
+			// only evade sweeps the predators, the rest have none of their own
+			vector<int> predatorCounts = (scenario == "evade") ? opt.predators : vector<int>{ 0 };
+			for (float radius : opt.radii) {
+				for (float neighbours : opt.neighbours) {
+					for (int predators : predatorCounts) {
+						Result res;
+						res.config = Config{ scenario, n, radius, neighbours, predators };
+
+						vector<vector<double>> samples(num_phases);
+						Simulation sim;
+						for (int r = 0; r < opt.reps; r++) {
+							vector<double> perBoid = runOnce(sim, res.config, opt);
+							for (int p = 0; p < num_phases; p++) samples[p].push_back(perBoid[p]);
+						}
+						res.boidsEnd = sim.boids().size();
+						for (int p = 0; p < num_phases; p++) res.phases[p] = summarize(samples[p]);
+						results.push_back(res);
+
+						log << scenario << " n=" << n << " r=" << radius << " k=" << neighbours;
+						if (scenario == "evade") log << " p=" << predators;
+						log << ":";
+						for (int p = 0; p < num_phases; p++) {
+							log << " " << phase_names[p] << " " << res.phases[p].mean << " +- " << res.phases[p].stddev;
+						}
+						log << endl;
+					}
+				}
+			}
+		}
+	}
+
+	if (opt.json == "-") {
+		writeJson(cout, results, opt, threads);
+	}
+	else if (!opt.json.empty()) {
+		ofstream file(opt.json);
+		if (!file) {
+			cerr << "Error: could not write " << opt.json << endl;
+			return 1;
+		}
+		writeJson(file, results, opt, threads);
+	}
+}
@@ -2,55 +2,59 @@
 
 // glm
 #include <gtc/random.hpp>
-#include <gtx\transform.hpp>
+#include <gtx/transform.hpp>
 
 // project
 #include "boid.hpp"
-#include "scene.hpp"
-#include "cgra/cgra_mesh.hpp"
+#include "simulation.hpp"
 #include <iostream>
 
-void Boid::calculateForces(Scene *scene) {
+void Boid::calculateForces(Simulation *sim, int i) {
+	BoidStore &store = sim->boids();
+	const FlockParams &params = sim->params(store.boidType(i));
+	glm::vec3 position = store.position(i);
 
 	// Boid flocking
-	if (boidType == 0) {
-		glm::vec3 avoidance = avoid(scene);	// Returns the avoidance force to apply
-		glm::vec3 coherence = cohere(scene); // Returns the coherence force to apply
-		glm::vec3 alignment = align(scene);	// Returns the alignment force to apply
-		// glm::vec3 evadePreds = evade(scene);
-
-		applyForce(avoidance * avoidWeight);
-		applyForce(alignment * alignWeight);
-		applyForce(coherence * cohereWeight);
-		// applyForce(evadePreds * evadeWeight); Boid evasion destroys everything else... :L
+	if (store.boidType(i) == 0) {
+		NeighbourSums sums = gatherNeighbours(sim, i);
+		glm::vec3 avoidance = avoid(sim, i, sums);	// Returns the avoidance force to apply
+		glm::vec3 coherence = cohere(sim, i, sums); // Returns the coherence force to apply
+		glm::vec3 alignment = align(sim, i, sums);	// Returns the alignment force to apply
+
+		applyForce(sim, i, avoidance * params.avoidWeight);
+		applyForce(sim, i, alignment * params.alignWeight);
+		applyForce(sim, i, coherence * params.cohereWeight);
+
+		// Predator evasion, when the field is on
+		if (sim->field().valid()) {
+			glm::vec3 evadePreds = evade(sim, i);
+			applyForce(sim, i, evadePreds * params.evadeWeight);
+		}
 
 	}
 	else {
-		if (activeBoidToSeek == nullptr) {
-			float nearestBoid = 10000;
-			for (int i = 0; i < scene->boids().size(); i++) {
-				Boid &b = scene->boids().at(i);
-				if (this == &b) continue; // Don't add ourselves -_-
-				if (b.boidType == 1) continue; // Don't seek other predators
-
-				if (glm::distance(b.m_position, m_position) < nearestBoid) {
-					nearestBoid = glm::distance(m_position, b.m_position);
-					boidIndexInList = i;
-					activeBoidToSeek = &b;
-				}
-			}
-		}
-		else {
-			glm::vec3 steering = seek(activeBoidToSeek->m_position);
-			applyForce(steering * predSeekForce);
+		// Our target is gone if another predator has eaten it
+		int target = store.index(targetBoid);
+
+		// Find the nearest boid when we have no target, and every retargetSteps
+		// steps in case a closer one has come along
+		if (target == -1 || (params.retargetSteps > 0 && --retargetCountdown <= 0)) {
+			// (the grid only holds prey, so no other predators or ourselves)
+			target = sim->grid().nearest(position, [](int) { return true; });
+			targetBoid = (target == -1) ? BoidHandle() : store.handle(target);
+			retargetCountdown = params.retargetSteps;
 		}
 
-		// If we've pretty much hit the boid, we need to set the null
-		if (activeBoidToSeek != nullptr) {
-			if (glm::distance(m_position, activeBoidToSeek->m_position) < hitTargetError) {
-				// Remove boid from list of boids (also deallocate boid)
-				activeBoidToSeek = nullptr;
-				scene->boids().erase(scene->boids().begin() + boidIndexInList);
+		if (target != -1) {
+			glm::vec3 prey = sim->grid().nearestImage(position, store.position(target));
+			glm::vec3 steering = seek(sim, i, prey);
+			applyForce(sim, i, steering * params.seekForce);
+
+			// If we've pretty much hit the boid, eat it and drop the target
+			if (glm::distance(position, prey) < params.hitTargetError) {
+				// Remove boid from list of boids (at the end of the step)
+				sim->commands().kill(i, store.handle(target));
+				targetBoid = BoidHandle();
 			}
 		}
 	}
@@ -75,159 +79,172 @@ void Boid::calculateForces(Scene *scene) {
 }
 
 
-void Boid::update(float timestep, Scene *scene) {
+glm::vec3 Boid::evade(Simulation *sim, int i) {
+	const BoidStore &store = sim->boids();
+	const FlockParams &params = sim->params(store.boidType(i));
 
-	switch (scene->wrappingType()) {
-	case 0: // 0 = Wrap
-		wrapBorders(scene);
-		break;
-	case 1: // 1 = Bounce
-		bounceBorders(scene);
-		break;
-	case 2: // 2 = Force Bounce
-		forceBounceBorders(scene);
-		break;
-	}
-
-	//-------------------------------------------------------------
-	// [Assignment 3] :
-	// Integrate the velocity of the boid using the timestep.
-	// Update the position of the boid using the new velocity.
-	// Take into account the bounds of the scene which may
-	// require you to change the velocity (if bouncing) or
-	// change the position (if wrapping).
-	//-------------------------------------------------------------
-	glm::vec3 oldVel = m_velocity;
-	m_velocity += m_acceleration * timestep;
+	// The field pushes up to about 1 per predator, fading to 0 at the edge
+	// of our sight, so the force eases in as a predator closes rather than
+	// turning us around the moment we see it
+	return sim->field().sample(store.position(i)) * params.maxAcceleration;
+}
 
-	if (boidType == 0) {
-		if (glm::length(m_velocity) < b_minVel()) {
-			m_velocity = b_minVel() * glm::normalize(m_velocity);
-		}
-		if (glm::length(m_velocity) > b_maxVel()) {
-			m_velocity = b_maxVel() * glm::normalize(m_velocity);
+NeighbourSums Boid::gatherNeighbours(Simulation *sim, int i) const {
+	NeighbourSums sums;
+	const BoidStore &store = sim->boids();
+	const float *x = store.x(), *y = store.y(), *z = store.z();
+	const float *vx = store.vx(), *vy = store.vy(), *vz = store.vz();
+	const int *flock = store.flock();
+	const FlockParams &params = sim->params(store.boidType(i));
+	glm::vec3 position = store.position(i);
+	int flockID = flock[i];
+	float avoidDist = currentAvoidDist(params);
+	float cohesionDist = params.cohesionDist;
+	float alignmentDist = params.alignmentDist;
+	float radius = glm::max(glm::max(avoidDist, cohesionDist), alignmentDist);
+
+	// topological mode takes the k nearest flocking boids, however far away
+	const SpatialGrid &grid = sim->grid();
+	if (sim->topological()) {
+		int nearest[SpatialGrid::s_max_neighbours];
+		int count = grid.nearestK(position, sim->settings().topologicalNeighbours, [&](int j) {
+			return j != i;
+		}, nearest);
+
+		for (int n = 0; n < count; n++) {
+			int j = nearest[n];
+			glm::vec3 other = grid.nearestImage(position, glm::vec3(x[j], y[j], z[j]));
+			float distance = glm::distance(position, other);
+			if (distance < avoidDist && distance != 0) {
+				sums.avoid += (position - other) / distance;
+				sums.numAvoid++;
+			}
+			if (flockID == flock[j]) {
+				sums.cohesion += other;
+				sums.numCohesion++;
+				sums.alignment += glm::vec3(vx[j], vy[j], vz[j]);
+				sums.numAlignment++;
+			}
 		}
+
+		// cohesion includes our own position, as in the metric mode
+		sums.cohesion += position;
+		sums.numCohesion++;
+		return sums;
 	}
-	else if (boidType == 1) {
-		if (glm::length(m_velocity) < p_minVel()) {
-			m_velocity = p_minVel() * glm::normalize(m_velocity);
-		}
-		if (glm::length(m_velocity) > b_maxVel()) {
-			m_velocity = p_maxVel() * glm::normalize(m_velocity);
-		}
+
+	// the Barnes-Hut tree, when in use, answers for every flocking boid
+	const FlockTree &tree = sim->tree();
+	if (tree.valid()) {
+		FlockTree::Sums approx = tree.gather(i, avoidDist, cohesionDist, alignmentDist, sim->settings().treeTheta);
+		sums.avoid = approx.avoid;
+		sums.cohesion = approx.cohesion;
+		sums.alignment = approx.alignment;
+		sums.numAvoid = approx.numAvoid;
+		sums.numCohesion = approx.numCohesion;
+		sums.numAlignment = approx.numAlignment;
+		return sums;
 	}
 
-	// framerate independent correct calculation:
-	// http://lolengine.net/blog/2011/12/14/understanding-motion-in-games
-	m_position += ((oldVel + m_velocity) * 0.5f * timestep);
+	// One pass over the neighbourhood collects the sums for all three behaviours
+	// (in wrap mode the nearest image of the other boid, across the walls)
+	auto visit = [&](int j) {
+		glm::vec3 other = grid.nearestImage(position, glm::vec3(x[j], y[j], z[j]));
+		float distance = glm::distance(position, other);
 
-	m_acceleration *= 0;
-}
+		// The grid only holds prey, predators are avoided in evade
+		// (distance != 0 skips ourselves)
+		if (distance < avoidDist && distance != 0) {
+			glm::vec3 dif = (position - other);
+			dif /= distance;
+			sums.avoid += dif;
+			sums.numAvoid++;
+		}
 
-glm::vec3 Boid::evade(Scene *scene) {
-	glm::vec3 steer(0);
-	for (Boid b : scene->boids()) {
-		if (b.boidType == 1 && boidType == 0 && b.flockID == -1) { // Predator
-			float distance = glm::distance(m_position, b.m_position);
-			if (distance < boidSeePredatorDist) {
-				glm::vec3 dif = m_position - b.m_position;
-				glm::normalize(dif);
-				dif /= distance;
-				return seek(-dif);
+		if (flockID == flock[j]) {
+			// Cohesion includes our own position, matching the old by-value loop
+			// where the (this == &b) check could never succeed
+			if (distance < cohesionDist) {
+				sums.cohesion += other;
+				sums.numCohesion++;
+			}
+			if (distance < alignmentDist && distance != 0) {
+				sums.alignment += glm::vec3(vx[j], vy[j], vz[j]);
+				sums.numAlignment++;
 			}
 		}
+	};
+
+	// the cached neighbour lists when they reach far enough (not while the
+	// avoid distance is widened), otherwise the grid's cell ordered runs
+	// through the neighbour kernel
+	const NeighbourList &list = sim->neighbours();
+	if (list.covers(radius)) {
+		for (const int *j = list.begin(i); j != list.end(i); j++) visit(*j);
 	}
-	return glm::vec3(0);
+	else {
+		NeighbourQuery q;
+		q.position = position;
+		q.flockID = flockID;
+		q.avoidDist2 = avoidDist * avoidDist;
+		q.cohesionDist2 = cohesionDist * cohesionDist;
+		q.alignmentDist2 = alignmentDist * alignmentDist;
+		q.periodic = grid.periodic();
+		q.period = grid.period();
+
+		CellArrays cells = grid.cellArrays();
+		NeighbourKernel kernel = neighbourKernel();
+		grid.queryRuns(position, radius, [&](int first, int last) {
+			kernel(q, cells, first, last, sums);
+		});
+	}
+
+	return sums;
 }
 
-glm::vec3 Boid::avoid(Scene *scene) {
-	float numBoids = 0;
-	glm::vec3 steer(0);
-	for (Boid b : scene->boids()) {
-		// If within sight distance
-		float distance = glm::distance(m_position, b.m_position);
-		if (distance < avoidDist && distance != 0) {
-			if (this == &b) continue; // if same obj, skip
-			// We only want to avoid our own flock. We also don't want to avoid predators here (b.flockID = -1)
-			// We will avoid predators in evadePredators method
-			if (b.flockID != -1) {
-				glm::vec3 dif = (m_position - b.m_position);
-				glm::normalize(dif);
-				dif /= distance;
-				steer += dif;
-				numBoids++;
-			}
-		}
-	}
+glm::vec3 Boid::avoid(Simulation *sim, int i, const NeighbourSums &sums) {
+	const FlockParams &params = sim->params(sim->boids().boidType(i));
+	glm::vec3 steer = sums.avoid;
 
 	// Average to avoid
-	if (numBoids > 0) {
-		steer /= numBoids;
+	if (sums.numAvoid > 0) {
+		steer /= sums.numAvoid;
 	}
 
 	if (glm::length(steer) != 0) {
-		glm::normalize(steer);
-		steer *= b_maxVel();
-		steer -= m_velocity;
+		steer *= params.maxVelocity;
+		steer -= sim->boids().velocity(i);
 
-		if (glm::length(steer) > b_maxAccel()) {
-			steer = b_maxAccel() * glm::normalize(steer);
+		if (glm::length(steer) > params.maxAcceleration) {
+			steer = params.maxAcceleration * glm::normalize(steer);
 		}
 	}
 	return steer;
 }
 
-glm::vec3 Boid::cohere(Scene *scene) {
-	glm::vec3 sumsPos(0);
-	float numBoids = 0;
-
-	for (Boid b : scene->boids()) {
-		// If within sight distance
-		if (glm::distance(m_position, b.m_position) < cohesionDist) {
-			if (this == &b) continue; // if same obj, skip
-			if (flockID == b.flockID && flockID != -1) {
-				numBoids++;
-				sumsPos += b.m_position;
-			}
-		}
-	}
-
-	if (expandingSight && numBoids != 0) {
+glm::vec3 Boid::cohere(Simulation *sim, int i, const NeighbourSums &sums) {
+	if (expandingSight && sums.numCohesion != 0) {
 		// We've found some birdy friends, lets reset our sight to default,
 		expandingSight = false;
-		avoidDist = defaultAvoidDist;
 	}
-	if (numBoids > 0) return seek(sumsPos / numBoids);
+	if (sums.numCohesion > 0) return seek(sim, i, sums.cohesion / sums.numCohesion);
 	else {
-		avoidDist = 50;
 		expandingSight = true;
 	}
 	return glm::vec3(0);
 }
 
-glm::vec3 Boid::align(Scene *scene) {
-	glm::vec3 sum(0);
-	float numBoids = 0;
-	
-	for (Boid b : scene->boids()) {
-		float distance = glm::distance(m_position, b.m_position);
-		if (distance < alignmentDist && distance != 0) {
-			if (this == &b) continue; // if same obj, skip
-			if (flockID == b.flockID && flockID != -1) {
-				sum += b.m_velocity;
-				numBoids++;
-			}
-		}
-	}
+glm::vec3 Boid::align(Simulation *sim, int i, const NeighbourSums &sums) {
+	const FlockParams &params = sim->params(sim->boids().boidType(i));
+	glm::vec3 sum = sums.alignment;
 
-	if (numBoids > 0) {
-		sum /= numBoids;
-		glm::normalize(sum);
-		sum *= b_maxVel();
-		glm::vec3 steer = sum - m_velocity;
+	if (sums.numAlignment > 0) {
+		sum /= sums.numAlignment;
+		sum *= params.maxVelocity;
+		glm::vec3 steer = sum - sim->boids().velocity(i);
 
-		if (glm::length(steer) > b_maxAccel()) {
-			steer = b_maxAccel() * glm::normalize(steer);
+		if (glm::length(steer) > params.maxAcceleration) {
+			steer = params.maxAcceleration * glm::normalize(steer);
 		}
 		return steer;
 	}
@@ -236,140 +253,35 @@ glm::vec3 Boid::align(Scene *scene) {
 
 // Functionality methods
 
-glm::vec3 Boid::seek(glm::vec3 target) {
-	glm::vec3 desired = target - m_position;
-	glm::normalize(desired);
-	if (boidType == 0) {
-		desired *= b_maxVel();
-	}
-	else {
-		desired *= p_maxVel();
-	}
+glm::vec3 Boid::seek(Simulation *sim, int i, glm::vec3 target) {
+	const BoidStore &store = sim->boids();
+	const FlockParams &params = sim->params(store.boidType(i));
 
-	glm::vec3 steer = desired - m_velocity;
+	glm::vec3 desired = target - store.position(i);
+	desired *= params.maxVelocity;
 
-	if (boidType == 0) {
-		if (glm::length(steer) > b_maxAccel()) {
-			steer = b_maxAccel() * glm::normalize(steer);
-		}
-	}
-	else {
-		if (glm::length(steer) > p_maxAccel()) {
-			steer = p_maxAccel() * glm::normalize(steer);
-		}
+	glm::vec3 steer = desired - store.velocity(i);
+
+	if (glm::length(steer) > params.maxAcceleration) {
+		steer = params.maxAcceleration * glm::normalize(steer);
 	}
 	return steer;
 }
 
-void Boid::applyForce(glm::vec3 force) {
-	if (boidType == 0) {
-		if (glm::length(force) > b_maxAccel()) {
-			force = b_maxAccel() * glm::normalize(force);
+void Boid::applyForce(Simulation *sim, int i, glm::vec3 force) {
+	BoidStore &store = sim->boids();
+	const FlockParams &params = sim->params(store.boidType(i));
 
-		}
-		m_acceleration += (force / b_mass());
-	}
-	else {
-		if (glm::length(force) > p_maxAccel()) {
-			force = p_maxAccel() * glm::normalize(force);
-		}
-		m_acceleration += (force / p_mass());
+	if (glm::length(force) > params.maxAcceleration) {
+		force = params.maxAcceleration * glm::normalize(force);
 	}
+	store.setAcceleration(i, store.acceleration(i) + (force / params.mass));
 }
 
-void Boid::applyForceWithoutLimits(glm::vec3 force) {
-	if (boidType == 0) {
-		m_acceleration += (force / b_mass());
-	}
-	else {
-		m_acceleration += (force / p_mass());
-	}
+void Boid::applyForceWithoutLimits(Simulation *sim, int i, glm::vec3 force) {
+	BoidStore &store = sim->boids();
+	const FlockParams &params = sim->params(store.boidType(i));
+	store.setAcceleration(i, store.acceleration(i) + (force / params.mass));
 }
 
 
-// Bounding methods
-
-void Boid::wrapBorders(Scene *scene) {
-	if (m_position.x < -scene->bound().x) m_position.x = scene->bound().x;
-	if (m_position.x > scene->bound().x) m_position.x = -scene->bound().x;
-
-	if (m_position.y < -scene->bound().y) m_position.y = scene->bound().y;
-	if (m_position.y > scene->bound().y) m_position.y = -scene->bound().y;
-
-	if (m_position.z < -scene->bound().z) m_position.z = scene->bound().z;
-	if (m_position.z > scene->bound().z) m_position.z = -scene->bound().z;
-}
-
-void Boid::bounceBorders(Scene *scene) {
-	if (m_position.x < -scene->bound().x || m_position.x > scene->bound().x) { m_velocity.x *= -1; }
-	if (m_position.y < -scene->bound().y || m_position.y > scene->bound().y) { m_velocity.y *= -1; }
-	if (m_position.z < -scene->bound().z || m_position.z > scene->bound().z) { m_velocity.z *= -1; }
-}
-
-void Boid::forceBounceBorders(Scene *scene) {
-		glm::vec3 desired(0);
-
-		if (m_position.x < -scene->bound().x) {
-			if (boidType == 0) {
-				desired = glm::vec3(b_maxVel(), m_velocity.y, m_velocity.z);
-			}
-			else {
-				desired = glm::vec3(p_maxVel(), m_velocity.y, m_velocity.z);
-			}
-		}
-		else if (m_position.x > scene->bound().x) {
-			if (boidType == 0) {
-				desired = glm::vec3(-b_maxVel(), m_velocity.y, m_velocity.z);
-			}
-			else {
-				desired = glm::vec3(-p_maxVel(), m_velocity.y, m_velocity.z);
-			}
-		}
-
-		if (m_position.y < -scene->bound().y) {
-			if (boidType == 0) {
-				desired = glm::vec3(m_velocity.x, b_maxVel(), m_velocity.z);
-			}
-			else {
-				desired = glm::vec3(m_velocity.x, p_maxVel(), m_velocity.z);
-			}
-		}
-		else if (m_position.y > scene->bound().y) {
-			if (boidType == 0) {
-				desired = glm::vec3(m_velocity.x, -b_maxVel(), m_velocity.z);
-			}
-			else {
-				desired = glm::vec3(m_velocity.x, -p_maxVel(), m_velocity.z);
-			}
-		}
-
-		if (m_position.z < -scene->bound().z) {
-			if (boidType == 0) {
-				desired = glm::vec3(m_velocity.x, m_velocity.y, b_maxVel());
-			}
-			else {
-				desired = glm::vec3(m_velocity.x, m_velocity.y, p_maxVel());
-			}
-		}
-		else if (m_position.z > scene->bound().z) {
-			if (boidType == 0) {
-				desired = glm::vec3(m_velocity.x, m_velocity.y, -b_maxVel());
-			}
-			else {
-				desired = glm::vec3(m_velocity.x, m_velocity.y, -p_maxVel());
-			}
-		}
-
-		if (glm::length(desired) != 0) {
-			glm::normalize(desired);
-			if (boidType == 0) {
-				desired *= b_maxVel();
-			}
-			else {
-				desired *= p_maxVel();
-			}
-			glm::vec3 steer = desired - m_velocity;
-
-			applyForce(steer);
-		}
-}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+
+// Stable reference to a boid in a BoidStore. Boids move around inside the
+// store when others are removed, so anything that needs to remember a boid
+// across steps (like a predator's target) holds one of these instead of an
+// index. The generation changes every time the slot is reused, so a handle
+// to a removed boid can always be told apart from its replacement.
+struct BoidHandle {
+	int slot			= -1;
+	unsigned generation	= 0;
+
+	bool operator==(const BoidHandle &o) const { return slot == o.slot && generation == o.generation; }
+	bool operator!=(const BoidHandle &o) const { return !(*this == o); }
+};
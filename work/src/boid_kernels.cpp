@@ -0,0 +1,303 @@
+// std
+#include <cmath>
+
+// project
+#include "boid_kernels.hpp"
+#include "cpu_features.hpp"
+
+
+namespace {
+
+	// Boid::update for a range of boids of type T. Written with selects
+	// rather than branches so the compiler can vectorise it, but the
+	// arithmetic is the same, in the same order, as the per boid version.
+	// (the arrays are restrict parameters so the compiler knows the stores
+	// can't alias the loads or the limits)
+	template <BoidType T>
+	BOIDS_FORCE_INLINE void integrateRange(float *__restrict x, float *__restrict y, float *__restrict z,
+		float *__restrict vx, float *__restrict vy, float *__restrict vz,
+		float *__restrict ax, float *__restrict ay, float *__restrict az,
+		const BoidLimits &l, float timestep, int first, int last)
+	{
+		const float minVel = l.minVelocity[int(T)];
+		const float maxVel = l.maxVelocity[int(T)];
+		const float speedCap = l.speedCap;
+
+		for (int i = first; i < last; i++) {
+			float ox = vx[i], oy = vy[i], oz = vz[i];
+			float nx = ox + ax[i] * timestep;
+			float ny = oy + ay[i] * timestep;
+			float nz = oz + az[i] * timestep;
+
+			// speed up to the minimum velocity
+			float d = nx * nx + ny * ny + nz * nz;
+			float inv = 1.0f / std::sqrt(d);
+			bool slow = std::sqrt(d) < minVel;
+			nx = slow ? minVel * (nx * inv) : nx;
+			ny = slow ? minVel * (ny * inv) : ny;
+			nz = slow ? minVel * (nz * inv) : nz;
+
+			// predators have always been checked against the normal boid max velocity
+			d = nx * nx + ny * ny + nz * nz;
+			inv = 1.0f / std::sqrt(d);
+			bool fast = std::sqrt(d) > speedCap;
+			nx = fast ? maxVel * (nx * inv) : nx;
+			ny = fast ? maxVel * (ny * inv) : ny;
+			nz = fast ? maxVel * (nz * inv) : nz;
+
+			// framerate independent correct calculation:
+			// http://lolengine.net/blog/2011/12/14/understanding-motion-in-games
+			x[i] += ((ox + nx) * 0.5f) * timestep;
+			y[i] += ((oy + ny) * 0.5f) * timestep;
+			z[i] += ((oz + nz) * 0.5f) * timestep;
+			vx[i] = nx;
+			vy[i] = ny;
+			vz[i] = nz;
+			ax[i] = 0;
+			ay[i] = 0;
+			az[i] = 0;
+		}
+	}
+
+	template <BoidType T>
+	BOIDS_FORCE_INLINE void integrateBody(const BoidArrays &b, const BoidLimits &l, float timestep, int first, int last) {
+		integrateRange<T>(b.x, b.y, b.z, b.vx, b.vy, b.vz, b.ax, b.ay, b.az, l, timestep, first, last);
+	}
+
+
+	BOIDS_FORCE_INLINE void wrapRange(float *__restrict x, float *__restrict y, float *__restrict z,
+		glm::vec3 bound, int first, int last)
+	{
+		for (int i = first; i < last; i++) {
+			float px = x[i], py = y[i], pz = z[i];
+			px = px < -bound.x ? bound.x : px;
+			px = px > bound.x ? -bound.x : px;
+			py = py < -bound.y ? bound.y : py;
+			py = py > bound.y ? -bound.y : py;
+			pz = pz < -bound.z ? bound.z : pz;
+			pz = pz > bound.z ? -bound.z : pz;
+			x[i] = px;
+			y[i] = py;
+			z[i] = pz;
+		}
+	}
+
+
+	BOIDS_FORCE_INLINE void bounceRange(const float *__restrict x, const float *__restrict y, const float *__restrict z,
+		float *__restrict vx, float *__restrict vy, float *__restrict vz, glm::vec3 bound, int first, int last)
+	{
+		for (int i = first; i < last; i++) {
+			vx[i] = (x[i] < -bound.x || x[i] > bound.x) ? -vx[i] : vx[i];
+			vy[i] = (y[i] < -bound.y || y[i] > bound.y) ? -vy[i] : vy[i];
+			vz[i] = (z[i] < -bound.z || z[i] > bound.z) ? -vz[i] : vz[i];
+		}
+	}
+
+
+	// steers boids of type T outside the box back in with a force (limited
+	// and scaled by mass as Boid::applyForce does)
+	template <BoidType T>
+	BOIDS_FORCE_INLINE void forceBounceRange(const float *__restrict x, const float *__restrict y, const float *__restrict z,
+		const float *__restrict vx, const float *__restrict vy, const float *__restrict vz,
+		float *__restrict ax, float *__restrict ay, float *__restrict az,
+		const BoidLimits &l, glm::vec3 bound, int first, int last)
+	{
+		const float maxVel = l.maxVelocity[int(T)];
+		const float maxAcc = l.maxAcceleration[int(T)];
+		const float mass = l.mass[int(T)];
+
+		for (int i = first; i < last; i++) {
+			float px = x[i], py = y[i], pz = z[i];
+			float ux = vx[i], uy = vy[i], uz = vz[i];
+
+			// the desired velocity turns back along the last axis we are outside on
+			bool outX = px < -bound.x || px > bound.x;
+			bool outY = py < -bound.y || py > bound.y;
+			bool outZ = pz < -bound.z || pz > bound.z;
+			float backX = px < -bound.x ? maxVel : -maxVel;
+			float backY = py < -bound.y ? maxVel : -maxVel;
+			float backZ = pz < -bound.z ? maxVel : -maxVel;
+
+			float dx = outZ ? ux : outY ? ux : outX ? backX : 0.0f;
+			float dy = outZ ? uy : outY ? backY : outX ? uy : 0.0f;
+			float dz = outZ ? backZ : outY ? uz : outX ? uz : 0.0f;
+			bool steering = std::sqrt(dx * dx + dy * dy + dz * dz) != 0;
+
+			float sx = dx * maxVel - ux;
+			float sy = dy * maxVel - uy;
+			float sz = dz * maxVel - uz;
+			float d = sx * sx + sy * sy + sz * sz;
+			float inv = 1.0f / std::sqrt(d);
+			bool limit = std::sqrt(d) > maxAcc;
+			sx = limit ? maxAcc * (sx * inv) : sx;
+			sy = limit ? maxAcc * (sy * inv) : sy;
+			sz = limit ? maxAcc * (sz * inv) : sz;
+
+			// (adding 0 rather than storing conditionally, which stops the loop
+			// vectorising. The accelerations start at +0 and only have forces
+			// added, so they are never -0 and adding 0 leaves them as they were.)
+			ax[i] += steering ? sx / mass : 0.0f;
+			ay[i] += steering ? sy / mass : 0.0f;
+			az[i] += steering ? sz / mass : 0.0f;
+		}
+	}
+
+
+	template <BoundsMode M, BoidType T>
+	BOIDS_FORCE_INLINE void boundsBody(const BoidArrays &b, const BoidLimits &l, glm::vec3 bound, int first, int last) {
+		if constexpr (M == BoundsMode::Wrap) {
+			wrapRange(b.x, b.y, b.z, bound, first, last);
+		}
+		else if constexpr (M == BoundsMode::Bounce) {
+			bounceRange(b.x, b.y, b.z, b.vx, b.vy, b.vz, bound, first, last);
+		}
+		else {
+			forceBounceRange<T>(b.x, b.y, b.z, b.vx, b.vy, b.vz, b.ax, b.ay, b.az, l, bound, first, last);
+		}
+	}
+
+
+	// Points the model along the velocity: the pitch (-asin(dir.y) about x)
+	// then yaw (atan2(dir.x, dir.z) about y) rotations, in closed form
+	BOIDS_FORCE_INLINE void transformBody(const glm::mat4 &view, const glm::vec3 *position, const glm::vec3 *previous,
+		const glm::vec3 *velocity, glm::vec3 bound, float alpha, glm::mat4 *out, int count)
+	{
+		for (int i = 0; i < count; i++) {
+
+			// get the boid direction (default to z if no velocity)
+			glm::vec3 v = velocity[i];
+			float inv = 1.0f / std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+			glm::vec3 dir = v * inv;
+			if (dir.x != dir.x) dir = glm::vec3(0, 0, 1);
+
+			// cos and sin of the yaw, and cos of the pitch
+			float h = std::sqrt(dir.x * dir.x + dir.z * dir.z);
+			float cosYaw = h > 0 ? dir.z / h : 1.0f;
+			float sinYaw = h > 0 ? dir.x / h : 0.0f;
+
+			// translate by the position, blended from the previous step unless
+			// the boid jumped more than the bounds along an axis (wrapped)
+			glm::vec3 p = position[i];
+			glm::vec3 moved = p - previous[i];
+			if (!glm::any(glm::greaterThan(glm::abs(moved), bound))) {
+				p = previous[i] + moved * alpha;
+			}
+
+			glm::mat4 model(
+				glm::vec4(cosYaw, 0, -sinYaw, 0),
+				glm::vec4(-sinYaw * dir.y, h, -cosYaw * dir.y, 0),
+				glm::vec4(sinYaw * h, dir.y, cosYaw * h, 0),
+				glm::vec4(p, 1));
+			out[i] = view * model;
+		}
+	}
+
+
+	// one copy of each kernel per instruction set. Scalar and SSE2 share the
+	// baseline build (SSE2 is the baseline on x86-64).
+	template <BoidType T>
+	void integrateBaseline(const BoidArrays &b, const BoidLimits &l, float timestep, int first, int last) {
+		integrateBody<T>(b, l, timestep, first, last);
+	}
+
+	template <BoundsMode M, BoidType T>
+	void boundsBaseline(const BoidArrays &b, const BoidLimits &l, glm::vec3 bound, int first, int last) {
+		boundsBody<M, T>(b, l, bound, first, last);
+	}
+
+	void transformBaseline(const glm::mat4 &view, const glm::vec3 *position, const glm::vec3 *previous,
+		const glm::vec3 *velocity, glm::vec3 bound, float alpha, glm::mat4 *out, int count)
+	{
+		transformBody(view, position, previous, velocity, bound, alpha, out, count);
+	}
+
+#ifdef BOIDS_X86
+	template <BoidType T>
+	BOIDS_TARGET("avx2") void integrateAVX2(const BoidArrays &b, const BoidLimits &l, float timestep, int first, int last) {
+		integrateBody<T>(b, l, timestep, first, last);
+	}
+
+	template <BoundsMode M, BoidType T>
+	BOIDS_TARGET("avx2") void boundsAVX2(const BoidArrays &b, const BoidLimits &l, glm::vec3 bound, int first, int last) {
+		boundsBody<M, T>(b, l, bound, first, last);
+	}
+
+	BOIDS_TARGET("avx2") void transformAVX2(const glm::mat4 &view, const glm::vec3 *position, const glm::vec3 *previous,
+		const glm::vec3 *velocity, glm::vec3 bound, float alpha, glm::mat4 *out, int count)
+	{
+		transformBody(view, position, previous, velocity, bound, alpha, out, count);
+	}
+
+	template <BoidType T>
+	BOIDS_TARGET("avx512f") void integrateAVX512(const BoidArrays &b, const BoidLimits &l, float timestep, int first, int last) {
+		integrateBody<T>(b, l, timestep, first, last);
+	}
+
+	template <BoundsMode M, BoidType T>
+	BOIDS_TARGET("avx512f") void boundsAVX512(const BoidArrays &b, const BoidLimits &l, glm::vec3 bound, int first, int last) {
+		boundsBody<M, T>(b, l, bound, first, last);
+	}
+
+	BOIDS_TARGET("avx512f") void transformAVX512(const glm::mat4 &view, const glm::vec3 *position, const glm::vec3 *previous,
+		const glm::vec3 *velocity, glm::vec3 bound, float alpha, glm::mat4 *out, int count)
+	{
+		transformBody(view, position, previous, velocity, bound, alpha, out, count);
+	}
+#endif
+
+
+	template <BoidType T>
+	IntegrateKernel integrateVariant() {
+		switch (simdLevel()) {
+#ifdef BOIDS_X86
+		case SimdLevel::AVX512: return integrateAVX512<T>;
+		case SimdLevel::AVX2: return integrateAVX2<T>;
+#endif
+		default: return integrateBaseline<T>;
+		}
+	}
+
+	template <BoundsMode M, BoidType T>
+	BoundsKernel boundsVariant() {
+		switch (simdLevel()) {
+#ifdef BOIDS_X86
+		case SimdLevel::AVX512: return boundsAVX512<M, T>;
+		case SimdLevel::AVX2: return boundsAVX2<M, T>;
+#endif
+		default: return boundsBaseline<M, T>;
+		}
+	}
+
+	template <BoundsMode M>
+	BoundsKernel boundsVariant(BoidType type) {
+		return (type == BoidType::Predator) ? boundsVariant<M, BoidType::Predator>() : boundsVariant<M, BoidType::Boid>();
+	}
+}
+
+
+IntegrateKernel integrateKernel(BoidType type) {
+	return (type == BoidType::Predator) ? integrateVariant<BoidType::Predator>() : integrateVariant<BoidType::Boid>();
+}
+
+
+BoundsKernel boundsKernel(BoundsMode mode, BoidType type) {
+	switch (mode) {
+	case BoundsMode::Wrap: return boundsVariant<BoundsMode::Wrap>(type);
+	case BoundsMode::Bounce: return boundsVariant<BoundsMode::Bounce>(type);
+	case BoundsMode::ForceBounce: return boundsVariant<BoundsMode::ForceBounce>(type);
+	default: return nullptr;
+	}
+}
+
+
+void buildTransforms(const glm::mat4 &view, const glm::vec3 *position, const glm::vec3 *previous,
+	const glm::vec3 *velocity, glm::vec3 bound, float alpha, glm::mat4 *out, int count)
+{
+	switch (simdLevel()) {
+#ifdef BOIDS_X86
+	case SimdLevel::AVX512: transformAVX512(view, position, previous, velocity, bound, alpha, out, count); break;
+	case SimdLevel::AVX2: transformAVX2(view, position, previous, velocity, bound, alpha, out, count); break;
+#endif
+	default: transformBaseline(view, position, previous, velocity, bound, alpha, out, count); break;
+	}
+}
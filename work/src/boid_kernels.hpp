@@ -0,0 +1,55 @@
+#pragma once
+
+// glm
+#include <glm.hpp>
+
+
+// Writable view of the BoidStore's hot arrays for the batch kernels
+struct BoidArrays {
+	float *x, *y, *z;
+	float *vx, *vy, *vz;
+	float *ax, *ay, *az;
+};
+
+
+// The cases the batch kernels are specialised for at compile time
+enum class BoundsMode { Wrap, Bounce, ForceBounce };	// as SceneSettings::boundsCollision
+enum class BoidType { Boid, Predator };				// as BoidStore::boidType
+
+
+// The parameters the batch kernels need, indexed by boid type
+struct BoidLimits {
+	float minVelocity[2];
+	float maxVelocity[2];
+	float maxAcceleration[2];
+	float mass[2];
+	float speedCap;		// the speed every type is clamped at (the normal boids' max velocity)
+};
+
+
+// Batch versions of the per boid integrate, bounds and draw steps. Each
+// one is a plain loop compiled once per SimdLevel (the compiler
+// vectorises it for that instruction set). They are elementwise, so every
+// variant gives the same results bit for bit.
+//
+// The integrate and bounds kernels are also instantiated per bounds mode
+// and boid type, so the loops have no per boid branches or parameter
+// lookups. Pick the kernel once for a run of boids of the same type.
+
+// integrates the velocities and positions of boids [first, last) and
+// clears their accelerations
+typedef void (*IntegrateKernel)(const BoidArrays &boids, const BoidLimits &limits, float timestep, int first, int last);
+
+// keeps boids [first, last) in the box [-bound, bound]
+typedef void (*BoundsKernel)(const BoidArrays &boids, const BoidLimits &limits, glm::vec3 bound, int first, int last);
+
+// the kernels for boids of one type, for the current simdLevel()
+IntegrateKernel integrateKernel(BoidType type);
+BoundsKernel boundsKernel(BoundsMode mode, BoidType type);	// null for an unknown mode
+
+// modelview matrices for drawing count boids, pointing along their
+// velocity at the position blended alpha of the way from previous (unless
+// the boid jumped more than bound along an axis, i.e. wrapped). Picks the
+// variant for the current simdLevel().
+void buildTransforms(const glm::mat4 &view, const glm::vec3 *position, const glm::vec3 *previous,
+	const glm::vec3 *velocity, glm::vec3 bound, float alpha, glm::mat4 *out, int count);
@@ -0,0 +1,44 @@
+#pragma once
+
+// std
+#include <random>
+
+// glm
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+
+
+// Random stream for one boid, seeded from the scene seed and the boid's
+// spawn number. Every boid draws from its own stream, so what a boid gets
+// does not depend on spawn order, other boids, or the number of threads.
+class BoidRandom {
+private:
+	std::mt19937 m_rng;
+
+public:
+	BoidRandom(unsigned seed, unsigned n) {
+		std::seed_seq seq{ seed, n };
+		m_rng.seed(seq);
+	}
+
+	// uniform in [lo, hi)
+	float uniform(float lo, float hi) {
+		return std::uniform_real_distribution<float>(lo, hi)(m_rng);
+	}
+
+	// uniform in the box [lo, hi) (same as glm::linearRand)
+	glm::vec3 linearRand(glm::vec3 lo, glm::vec3 hi) {
+		float x = uniform(lo.x, hi.x);
+		float y = uniform(lo.y, hi.y);
+		float z = uniform(lo.z, hi.z);
+		return glm::vec3(x, y, z);
+	}
+
+	// uniform on the sphere of the given radius (same as glm::sphericalRand)
+	glm::vec3 sphericalRand(float radius) {
+		float z = uniform(-1, 1);
+		float a = uniform(0, glm::two_pi<float>());
+		float r = glm::sqrt(1 - z * z);
+		return glm::vec3(r * glm::cos(a), r * glm::sin(a), z) * radius;
+	}
+};
@@ -0,0 +1,159 @@
+// std
+#include <utility>
+
+// project
+#include "boid_store.hpp"
+
+
+namespace {
+
+	// v[k] = old v[order[k]], through scratch (which ends up with the old v)
+	template <typename T>
+	void gather(std::vector<T> &v, const std::vector<int> &order, std::vector<T> &scratch) {
+		scratch.resize(order.size());
+		for (size_t k = 0; k < order.size(); k++) scratch[k] = std::move(v[order[k]]);
+		v.swap(scratch);
+	}
+}
+
+
+void BoidStore::clear() {
+	m_version++;
+	m_x.clear(); m_y.clear(); m_z.clear();
+	m_vx.clear(); m_vy.clear(); m_vz.clear();
+	m_ax.clear(); m_ay.clear(); m_az.clear();
+	m_flock.clear();
+	m_type.clear();
+	m_num_prey = 0;
+	m_cold.clear();
+	m_previous.clear();
+
+	// every live handle goes stale
+	for (size_t s = 0; s < m_generation.size(); s++) {
+		if (m_slot_index[s] != -1) {
+			m_slot_index[s] = -1;
+			m_generation[s]++;
+			m_free_slots.push_back(int(s));
+		}
+	}
+	m_slot.clear();
+}
+
+
+void BoidStore::reserve(size_t n) {
+	m_x.reserve(n); m_y.reserve(n); m_z.reserve(n);
+	m_vx.reserve(n); m_vy.reserve(n); m_vz.reserve(n);
+	m_ax.reserve(n); m_ay.reserve(n); m_az.reserve(n);
+	m_flock.reserve(n);
+	m_type.reserve(n);
+	m_cold.reserve(n);
+	m_previous.reserve(n);
+	m_slot.reserve(n);
+}
+
+
+BoidHandle BoidStore::push_back(glm::vec3 pos, glm::vec3 vel, int flockID, glm::vec3 col, int type) {
+	m_version++;
+	m_x.push_back(pos.x); m_y.push_back(pos.y); m_z.push_back(pos.z);
+	m_vx.push_back(vel.x); m_vy.push_back(vel.y); m_vz.push_back(vel.z);
+	m_ax.push_back(0); m_ay.push_back(0); m_az.push_back(0);
+	m_flock.push_back(flockID);
+	m_type.push_back(type);
+	m_cold.push_back(Boid(col));
+	m_previous.push_back(pos);
+
+	// reuse a free slot if there is one
+	int slot;
+	if (m_free_slots.empty()) {
+		slot = int(m_generation.size());
+		m_generation.push_back(0);
+		m_slot_index.push_back(0);
+	}
+	else {
+		slot = m_free_slots.back();
+		m_free_slots.pop_back();
+	}
+	m_slot_index[slot] = int(m_slot.size());
+	m_slot.push_back(slot);
+
+	// prey go in front of the predators, the first predator moves to the end
+	if (type == 0) {
+		swapBoids(m_num_prey, m_slot.size() - 1);
+		m_num_prey++;
+	}
+
+	return BoidHandle{ slot, m_generation[slot] };
+}
+
+
+void BoidStore::erase(size_t i) {
+	m_version++;
+
+	// move the boid to the end of the prey if it is one (and the last
+	// predator into the hole that leaves), then to the end of the store
+	if (m_type[i] == 0) {
+		m_num_prey--;
+		swapBoids(i, m_num_prey);
+		i = m_num_prey;
+	}
+	size_t last = m_slot.size() - 1;
+	swapBoids(i, last);
+
+	// free the slot and invalidate its handles
+	int slot = m_slot[last];
+	m_slot_index[slot] = -1;
+	m_generation[slot]++;
+	m_free_slots.push_back(slot);
+
+	m_x.pop_back(); m_y.pop_back(); m_z.pop_back();
+	m_vx.pop_back(); m_vy.pop_back(); m_vz.pop_back();
+	m_ax.pop_back(); m_ay.pop_back(); m_az.pop_back();
+	m_flock.pop_back();
+	m_type.pop_back();
+	m_cold.pop_back();
+	m_previous.pop_back();
+	m_slot.pop_back();
+}
+
+
+void BoidStore::swapBoids(size_t i, size_t j) {
+	if (i == j) return;
+	std::swap(m_x[i], m_x[j]); std::swap(m_y[i], m_y[j]); std::swap(m_z[i], m_z[j]);
+	std::swap(m_vx[i], m_vx[j]); std::swap(m_vy[i], m_vy[j]); std::swap(m_vz[i], m_vz[j]);
+	std::swap(m_ax[i], m_ax[j]); std::swap(m_ay[i], m_ay[j]); std::swap(m_az[i], m_az[j]);
+	std::swap(m_flock[i], m_flock[j]);
+	std::swap(m_type[i], m_type[j]);
+	std::swap(m_cold[i], m_cold[j]);
+	std::swap(m_previous[i], m_previous[j]);
+	std::swap(m_slot[i], m_slot[j]);
+	m_slot_index[m_slot[i]] = int(i);
+	m_slot_index[m_slot[j]] = int(j);
+}
+
+
+void BoidStore::savePositions() {
+	for (size_t i = 0; i < m_previous.size(); i++) {
+		m_previous[i] = position(i);
+	}
+}
+
+
+void BoidStore::reorder(const std::vector<int> &order) {
+	m_version++;
+
+	gather(m_x, order, m_scratch_float); gather(m_y, order, m_scratch_float); gather(m_z, order, m_scratch_float);
+	gather(m_vx, order, m_scratch_float); gather(m_vy, order, m_scratch_float); gather(m_vz, order, m_scratch_float);
+	gather(m_ax, order, m_scratch_float); gather(m_ay, order, m_scratch_float); gather(m_az, order, m_scratch_float);
+	gather(m_flock, order, m_scratch_int);
+	gather(m_type, order, m_scratch_int);
+	gather(m_cold, order, m_scratch_cold);
+	gather(m_previous, order, m_scratch_vec3);
+	gather(m_slot, order, m_scratch_int);
+
+	// handles follow their slots to the new indices
+	m_remap.resize(order.size());
+	for (size_t k = 0; k < order.size(); k++) {
+		m_remap[order[k]] = int(k);
+		m_slot_index[m_slot[k]] = int(k);
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+// std
+#include <vector>
+
+// glm
+#include <glm.hpp>
+
+// project
+#include "boid.hpp"
+#include "boid_kernels.hpp"
+
+
+// Structure-of-arrays storage for the boids in a scene.
+// The hot kernels (neighbour search and integration) only stream the
+// position, velocity, acceleration, flock and type arrays. Everything
+// else (colour, tuning parameters, seeking state) lives in the cold Boid
+// records, which are kept in the same order as the hot arrays.
+//
+// The boids are partitioned by type: prey (normal boids) are indices
+// [0, numPrey()) and predators [numPrey(), size()). Prey loops and the
+// neighbour grid never see a predator, and predator scans only touch the
+// few boids at the end.
+//
+// Removal and insertion swap boids around within their range (O(1)), so
+// indices are only stable between structural changes. A slot map hands out
+// generational BoidHandles that stay valid (or detectably stale) across
+// removals.
+class BoidStore {
+private:
+	// hot data
+	std::vector<float> m_x, m_y, m_z;
+	std::vector<float> m_vx, m_vy, m_vz;
+	std::vector<float> m_ax, m_ay, m_az;
+	std::vector<int> m_flock;	// 0 or 1 for completion (two flocks). -1 if it's a predator
+	std::vector<int> m_type;	// 0 - normal boid, 1 - predator boid
+	int m_num_prey = 0;			// prey are [0, m_num_prey), predators after them
+
+	// cold data
+	std::vector<Boid> m_cold;
+	std::vector<glm::vec3> m_previous;	// position before the last step (for render interpolation)
+
+	// slot map
+	std::vector<int> m_slot;			// index -> slot
+	std::vector<int> m_slot_index;		// slot -> index, -1 if the slot is free
+	std::vector<unsigned> m_generation;	// slot -> generation, bumped when the slot is freed
+	std::vector<int> m_free_slots;
+
+	unsigned m_version = 0;	// bumped by every structural change
+	std::vector<int> m_remap;	// old index -> new index for the last reorder
+
+	// reorder scratch, one per element type. Each array is permuted into
+	// its scratch and swapped with it, so reordering doesn't allocate
+	// unless the store has grown.
+	std::vector<float> m_scratch_float;
+	std::vector<int> m_scratch_int;
+	std::vector<Boid> m_scratch_cold;
+	std::vector<glm::vec3> m_scratch_vec3;
+
+	// swaps the boids at indices i and j (their handles follow them)
+	void swapBoids(size_t i, size_t j);
+
+public:
+	size_t size() const { return m_cold.size(); }
+	bool empty() const { return m_cold.empty(); }
+
+	void clear();
+	void reserve(size_t n);
+	BoidHandle push_back(glm::vec3 pos, glm::vec3 vel, int flockID, glm::vec3 col, int type);
+
+	// number of prey, which come before every predator
+	int numPrey() const { return m_num_prey; }
+
+	// removes boid i in O(1) by moving the last boid of its range into its
+	// place (and, for prey, the last predator into the prey range's end)
+	void erase(size_t i);
+
+	// moves the boid at index order[k] to index k, for every k (order must
+	// be a permutation of the indices that keeps the prey first). Handles
+	// stay valid.
+	void reorder(const std::vector<int> &order);
+
+	// old index -> new index for the last reorder, for anyone holding raw indices
+	const std::vector<int> &remap() const { return m_remap; }
+
+	// changes whenever boids are added, removed or moved to other indices
+	unsigned version() const { return m_version; }
+
+	// handle for the boid currently at index i
+	BoidHandle handle(size_t i) const { return BoidHandle{ m_slot[i], m_generation[m_slot[i]] }; }
+
+	// current index of the boid, or -1 if it has been removed
+	int index(BoidHandle h) const {
+		if (h.slot < 0 || h.slot >= int(m_generation.size())) return -1;
+		if (m_generation[h.slot] != h.generation) return -1;
+		return m_slot_index[h.slot];
+	}
+
+	glm::vec3 position(size_t i) const { return glm::vec3(m_x[i], m_y[i], m_z[i]); }
+	glm::vec3 velocity(size_t i) const { return glm::vec3(m_vx[i], m_vy[i], m_vz[i]); }
+	glm::vec3 acceleration(size_t i) const { return glm::vec3(m_ax[i], m_ay[i], m_az[i]); }
+	int flockID(size_t i) const { return m_flock[i]; }
+	int boidType(size_t i) const { return m_type[i]; }
+
+	glm::vec3 previousPosition(size_t i) const { return m_previous[i]; }
+
+	// remembers the current positions as the previous state
+	void savePositions();
+
+	void setPosition(size_t i, glm::vec3 p) { m_x[i] = p.x; m_y[i] = p.y; m_z[i] = p.z; }
+	void setVelocity(size_t i, glm::vec3 v) { m_vx[i] = v.x; m_vy[i] = v.y; m_vz[i] = v.z; }
+	void setAcceleration(size_t i, glm::vec3 a) { m_ax[i] = a.x; m_ay[i] = a.y; m_az[i] = a.z; }
+
+	// raw arrays for the kernels
+	const float *x() const { return m_x.data(); }
+	const float *y() const { return m_y.data(); }
+	const float *z() const { return m_z.data(); }
+	const float *vx() const { return m_vx.data(); }
+	const float *vy() const { return m_vy.data(); }
+	const float *vz() const { return m_vz.data(); }
+	const int *flock() const { return m_flock.data(); }
+	const int *type() const { return m_type.data(); }
+
+	// writable hot arrays for the batch kernels
+	BoidArrays arrays() {
+		return BoidArrays{ m_x.data(), m_y.data(), m_z.data(), m_vx.data(), m_vy.data(), m_vz.data(),
+			m_ax.data(), m_ay.data(), m_az.data() };
+	}
+
+	// end of the run of boids of the same type as boid first, stopping at last
+	int typeRunEnd(int first, int last) const {
+		return (first < m_num_prey) ? glm::min(last, m_num_prey) : last;
+	}
+
+	// cold per-boid records
+	Boid &operator[](size_t i) { return m_cold[i]; }
+	const Boid &operator[](size_t i) const { return m_cold[i]; }
+	std::vector<Boid> &cold() { return m_cold; }
+	const std::vector<Boid> &cold() const { return m_cold; }
+};
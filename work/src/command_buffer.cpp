@@ -0,0 +1,104 @@
+// std
+#include <algorithm>
+
+// OpenMP
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// project
+#include "command_buffer.hpp"
+#include "boid_store.hpp"
+
+
+std::vector<BoidCommand> &CommandBuffer::local() {
+#ifdef _OPENMP
+	return m_threads[omp_get_thread_num()];
+#else
+	return m_threads[0];
+#endif
+}
+
+
+void CommandBuffer::begin() {
+#ifdef _OPENMP
+	size_t threads = size_t(omp_get_max_threads());
+#else
+	size_t threads = 1;
+#endif
+	if (m_threads.size() < threads) m_threads.resize(threads);
+	for (std::vector<BoidCommand> &buffer : m_threads) buffer.clear();
+}
+
+
+void CommandBuffer::kill(int issuer, BoidHandle target) {
+	BoidCommand c = {};
+	c.type = BoidCommand::Kill;
+	c.issuer = issuer;
+	c.target = target;
+	local().push_back(c);
+}
+
+
+void CommandBuffer::recolor(int issuer, BoidHandle target, glm::vec3 color) {
+	BoidCommand c = {};
+	c.type = BoidCommand::Recolor;
+	c.issuer = issuer;
+	c.target = target;
+	c.color = color;
+	local().push_back(c);
+}
+
+
+void CommandBuffer::spawn(int issuer, glm::vec3 pos, glm::vec3 vel, int flockID, glm::vec3 col, int type) {
+	BoidCommand c = {};
+	c.type = BoidCommand::Spawn;
+	c.issuer = issuer;
+	c.position = pos;
+	c.velocity = vel;
+	c.color = col;
+	c.flockID = flockID;
+	c.boidType = type;
+	local().push_back(c);
+}
+
+
+void CommandBuffer::apply(BoidStore &store) {
+	// merge, keeping each issuer's commands in the order it made them
+	m_merged.clear();
+	for (std::vector<BoidCommand> &buffer : m_threads) {
+		m_merged.insert(m_merged.end(), buffer.begin(), buffer.end());
+		buffer.clear();
+	}
+	if (m_merged.empty()) return;
+	std::stable_sort(m_merged.begin(), m_merged.end(), [](const BoidCommand &a, const BoidCommand &b) {
+		return a.issuer < b.issuer;
+	});
+
+	// recolours and kills refer to boids that exist right now
+	m_kills.clear();
+	for (const BoidCommand &c : m_merged) {
+		int i = store.index(c.target);
+		if (i == -1) continue;
+		if (c.type == BoidCommand::Recolor) store[i].setColor(c.color);
+		else if (c.type == BoidCommand::Kill) m_kills.push_back(i);
+	}
+
+	// several predators can catch the same boid in one step
+	std::sort(m_kills.begin(), m_kills.end());
+	m_kills.erase(std::unique(m_kills.begin(), m_kills.end()), m_kills.end());
+
+	// Erase back to front. A removal only moves boids from higher indices
+	// (the last prey and the last boid) into the holes, and those are never
+	// ones still waiting to be removed.
+	for (auto it = m_kills.rbegin(); it != m_kills.rend(); ++it) {
+		store.erase(*it);
+	}
+
+	for (const BoidCommand &c : m_merged) {
+		if (c.type == BoidCommand::Spawn) {
+			store.push_back(c.position, c.velocity, c.flockID, c.color, c.boidType);
+		}
+	}
+	m_merged.clear();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// std
+#include <vector>
+
+// glm
+#include <glm.hpp>
+
+// project
+#include "boid_handle.hpp"
+
+
+// foward declare boid store class
+class BoidStore;
+
+
+// A structural change to the boids requested during a step
+struct BoidCommand {
+	enum Type { Kill, Recolor, Spawn };
+
+	Type type;
+	int issuer;				// index of the boid that asked for it (-1 for the scene), used for ordering
+	BoidHandle target;		// Kill, Recolor
+	glm::vec3 position;		// Spawn
+	glm::vec3 velocity;		// Spawn
+	glm::vec3 color;		// Recolor, Spawn
+	int flockID;			// Spawn
+	int boidType;			// Spawn
+};
+
+
+// Collects spawn/kill/recolour requests while the step is running so the
+// hot loops never change the boid store. Each thread appends to its own
+// buffer without locking, and apply() merges them and makes all the
+// changes in one pass at the end of the step.
+class CommandBuffer {
+private:
+	std::vector<std::vector<BoidCommand>> m_threads;
+	std::vector<BoidCommand> m_merged;
+	std::vector<int> m_kills;
+
+	std::vector<BoidCommand> &local();
+
+public:
+	// sizes the per-thread buffers, call before the parallel loops
+	void begin();
+
+	void kill(int issuer, BoidHandle target);
+	void recolor(int issuer, BoidHandle target, glm::vec3 color);
+	void spawn(int issuer, glm::vec3 pos, glm::vec3 vel, int flockID, glm::vec3 col, int type);
+
+	// Applies everything queued since begin(). Commands are ordered by issuer
+	// so the result doesn't depend on how the boids were split over threads.
+	// Recolours are applied first, then kills, then spawns.
+	void apply(BoidStore &store);
+};
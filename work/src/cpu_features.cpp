@@ -0,0 +1,101 @@
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// project
+#include "cpu_features.hpp"
+
+
+using namespace std;
+
+
+namespace {
+	SimdLevel detect() {
+#if !defined(BOIDS_X86)
+		return SimdLevel::Scalar;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		if (!sse2) return SimdLevel::Scalar;
+		if (!osxsave || maxLeaf < 7) return SimdLevel::SSE2;
+
+		// the OS has to save the wider registers too
+		unsigned long long xcr0 = _xgetbv(0);
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x06) == 0x06;
+		bool avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+		if (avx512) return SimdLevel::AVX512;
+		if (avx2) return SimdLevel::AVX2;
+		return SimdLevel::SSE2;
+#else
+		// (these check the OS support as well)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+		if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+		if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	SimdLevel initialLevel() {
+		SimdLevel level = detectSimdLevel();
+		const char *env = getenv("BOIDS_SIMD");
+		SimdLevel requested;
+		if (env && parseSimdLevel(env, requested)) level = min(level, requested);
+		return level;
+	}
+
+	atomic<int> &activeLevel() {
+		static atomic<int> level{ int(initialLevel()) };
+		return level;
+	}
+}
+
+
+SimdLevel detectSimdLevel() {
+	static const SimdLevel level = detect();
+	return level;
+}
+
+
+SimdLevel simdLevel() {
+	return SimdLevel(activeLevel().load(memory_order_relaxed));
+}
+
+
+SimdLevel setSimdLevel(SimdLevel level) {
+	level = min(level, detectSimdLevel());
+	activeLevel().store(int(level), memory_order_relaxed);
+	return level;
+}
+
+
+const char *simdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::SSE2: return "sse2";
+	case SimdLevel::AVX2: return "avx2";
+	case SimdLevel::AVX512: return "avx512";
+	default: return "scalar";
+	}
+}
+
+
+bool parseSimdLevel(const string &name, SimdLevel &level) {
+	for (SimdLevel l : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 }) {
+		if (name == simdLevelName(l)) {
+			level = l;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// std
+#include <string>
+
+
+// The instruction sets the hot kernels are compiled for, in increasing
+// order. Every variant is built into the same binary (see BOIDS_TARGET)
+// and the kernels pick theirs from simdLevel() at runtime, so one build
+// runs at full speed on every x86 host and falls back to scalar elsewhere.
+enum class SimdLevel { Scalar, SSE2, AVX2, AVX512 };
+
+// best level the CPU and OS support (cpuid, checked once)
+SimdLevel detectSimdLevel();
+
+// level the kernels run at. Starts at detectSimdLevel(), lowered by the
+// BOIDS_SIMD environment variable if it is set (scalar, sse2, avx2, avx512).
+SimdLevel simdLevel();
+
+// forces the kernels to a level (clamped to what the host supports),
+// returns the level now in use
+SimdLevel setSimdLevel(SimdLevel level);
+
+const char *simdLevelName(SimdLevel level);
+
+// parses a level name, returns false if it isn't one
+bool parseSimdLevel(const std::string &name, SimdLevel &level);
+
+
+// Marks a function to be compiled for an instruction set other than the
+// build's baseline (GCC/Clang). MSVC needs no attribute for intrinsics,
+// its plain code just stays at the baseline.
+#if defined(__GNUC__) || defined(__clang__)
+#define BOIDS_TARGET(isa) __attribute__((target(isa)))
+#define BOIDS_FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define BOIDS_TARGET(isa)
+#define BOIDS_FORCE_INLINE __forceinline
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define BOIDS_X86
+#endif
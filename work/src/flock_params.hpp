@@ -0,0 +1,47 @@
+#pragma once
+
+
+// Tuning parameters shared by every boid of one type. The scene keeps
+// one block per boid type (0 - normal boid, 1 - predator boid) so the
+// kernels read them once instead of every boid carrying its own copy.
+struct FlockParams {
+	float mass				= 1.0f;
+	float minVelocity		= 9.0f;
+	float maxVelocity		= 28.0f;
+	float maxAcceleration	= 70.0f;
+
+	// Each behaviour has an individual distance parameter (and a weight too)
+	float cohesionDist		= 1.0f;
+	float avoidDist			= 1.0f;
+	float alignmentDist		= 1.0f;
+	float seePredatorDist	= 1.0f;
+
+	// Weights
+	float avoidWeight		= 1.0f;
+	float cohereWeight		= 1.0f;
+	float alignWeight		= 1.0f;
+	float evadeWeight		= 1.0f;
+
+	// Predator seeking
+	float seekForce			= 100.0f;
+	float hitTargetError	= 1.1f; // Collision distance error check (to handle radius of boid)
+	int retargetSteps		= 30;	// steps between looking for a closer target (0 = only when we have none)
+};
+
+
+// default parameters for normal boids
+inline FlockParams boidParams() {
+	FlockParams p;
+	p.seePredatorDist = 5.0f;
+	return p;
+}
+
+// default parameters for predator boids
+inline FlockParams predatorParams() {
+	FlockParams p;
+	p.mass = 2.0f;
+	p.minVelocity = 1.0f;
+	p.maxVelocity = 22.0f;
+	p.maxAcceleration = 125.0f;
+	return p;
+}
@@ -0,0 +1,235 @@
+// std
+#include <algorithm>
+
+// project
+#include "flock_tree.hpp"
+
+
+namespace {
+	// spreads the low 10 bits of v out to every third bit
+	uint32_t spreadBits(uint32_t v) {
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+}
+
+
+void FlockTree::build(const BoidStore &boids) {
+	m_boids = &boids;
+	int count = boids.numPrey();	// the flocking boids
+	const float *x = boids.x(), *y = boids.y(), *z = boids.z();
+	const int *flock = boids.flock();
+
+	// cube around every flocking boid, quantised to 10 bits per axis
+	glm::vec3 lo(0), hi(0);
+	int maxFlock = -1;
+	for (int i = 0; i < count; i++) {
+		glm::vec3 p(x[i], y[i], z[i]);
+		lo = (maxFlock == -1) ? p : glm::min(lo, p);
+		hi = (maxFlock == -1) ? p : glm::max(hi, p);
+		maxFlock = std::max(maxFlock, flock[i]);
+	}
+	float extent = std::max(std::max(hi.x - lo.x, hi.y - lo.y), std::max(hi.z - lo.z, 1e-6f));
+	float scale = 1023.0f / extent;
+
+	// sort by flock, then by Morton key, so every flock's boids are one
+	// run and every octant of a node is one run inside it
+	m_keys.clear();
+	for (int i = 0; i < count; i++) {
+		glm::uvec3 q = glm::uvec3((glm::vec3(x[i], y[i], z[i]) - lo) * scale);
+		uint32_t morton = spreadBits(q.x) | (spreadBits(q.y) << 1) | (spreadBits(q.z) << 2);
+		m_keys.emplace_back((uint64_t(flock[i]) << 32) | morton, i);
+	}
+	std::sort(m_keys.begin(), m_keys.end());
+
+	int numSorted = int(m_keys.size());
+	m_sorted.resize(numSorted);
+	m_rank.assign(count, -1);
+	for (int k = 0; k < numSorted; k++) {
+		m_sorted[k] = m_keys[k].second;
+		m_rank[m_keys[k].second] = k;
+	}
+
+	m_nodes.clear();
+	m_roots.assign(maxFlock + 1, -1);
+	for (int first = 0; first < numSorted; ) {
+		int f = flock[m_sorted[first]];
+		int last = first;
+		while (last < numSorted && flock[m_sorted[last]] == f) last++;
+
+		m_roots[f] = int(m_nodes.size());
+		m_nodes.emplace_back();
+		buildNode(m_roots[f], first, last, 0);
+		first = last;
+	}
+	m_valid = true;
+}
+
+
+void FlockTree::buildNode(int node, int first, int last, int depth) {
+	const BoidStore &boids = *m_boids;
+	m_nodes[node].first = first;
+	m_nodes[node].last = last;
+
+	if (last - first <= s_leaf_size || depth >= s_max_depth) {
+		int i = m_sorted[first];
+		glm::vec3 lo = boids.position(i), hi = lo, sumPosition(0), sumVelocity(0);
+		for (int k = first; k < last; k++) {
+			i = m_sorted[k];
+			glm::vec3 p = boids.position(i);
+			lo = glm::min(lo, p);
+			hi = glm::max(hi, p);
+			sumPosition += p;
+			sumVelocity += boids.velocity(i);
+		}
+		Node &n = m_nodes[node];
+		n.lo = lo;
+		n.hi = hi;
+		n.sumPosition = sumPosition;
+		n.sumVelocity = sumVelocity;
+		return;
+	}
+
+	// split into the non-empty octants, allocated together so the
+	// children are contiguous
+	int shift = 3 * (s_max_depth - 1 - depth);
+	int bounds[9];
+	int numChildren = 0;
+	bounds[0] = first;
+	for (int k = first + 1; k < last; k++) {
+		if (((m_keys[k].first ^ m_keys[k - 1].first) >> shift) != 0) bounds[++numChildren] = k;
+	}
+	bounds[++numChildren] = last;
+
+	int firstChild = int(m_nodes.size());
+	m_nodes.resize(m_nodes.size() + numChildren);
+	m_nodes[node].firstChild = firstChild;
+	m_nodes[node].numChildren = numChildren;
+	for (int c = 0; c < numChildren; c++) {
+		buildNode(firstChild + c, bounds[c], bounds[c + 1], depth + 1);
+	}
+
+	// m_nodes may have moved while building the children
+	Node &n = m_nodes[node];
+	n.lo = m_nodes[firstChild].lo;
+	n.hi = m_nodes[firstChild].hi;
+	n.sumPosition = glm::vec3(0);
+	n.sumVelocity = glm::vec3(0);
+	for (int c = firstChild; c < firstChild + numChildren; c++) {
+		n.lo = glm::min(n.lo, m_nodes[c].lo);
+		n.hi = glm::max(n.hi, m_nodes[c].hi);
+		n.sumPosition += m_nodes[c].sumPosition;
+		n.sumVelocity += m_nodes[c].sumVelocity;
+	}
+}
+
+
+struct FlockTree::Query {
+	int self;
+	int rank;				// self's position in m_sorted (-1 if not flocking)
+	glm::vec3 position;
+	float radius2[3];		// avoid, cohesion, alignment
+	float theta2;
+};
+
+
+FlockTree::Sums FlockTree::gather(int i, float avoidDist, float cohesionDist, float alignmentDist, float theta) const {
+	Sums sums;
+	if (!m_valid) return sums;
+
+	Query q;
+	q.self = i;
+	q.rank = m_rank[i];
+	q.position = m_boids->position(i);
+	q.radius2[0] = avoidDist * avoidDist;
+	q.radius2[1] = cohesionDist * cohesionDist;
+	q.radius2[2] = alignmentDist * alignmentDist;
+	q.theta2 = theta * theta;
+
+	// every flock is avoided, only our own is cohered with and aligned to
+	int flockID = m_boids->flockID(i);
+	for (int f = 0; f < int(m_roots.size()); f++) {
+		if (m_roots[f] != -1) gather(q, m_roots[f], (f == flockID) ? 7 : 1, sums);
+	}
+	return sums;
+}
+
+
+void FlockTree::gather(const Query &q, int node, int active, Sums &sums) const {
+	const Node &n = m_nodes[node];
+	const glm::vec3 p = q.position;
+	float count = float(n.last - n.first);
+	bool containsSelf = q.rank >= n.first && q.rank < n.last;
+
+	// nearest and farthest points of the node's bounds
+	glm::vec3 nearest = glm::max(glm::max(n.lo - p, p - n.hi), glm::vec3(0));
+	glm::vec3 farthest = glm::max(glm::abs(p - n.lo), glm::abs(p - n.hi));
+	float near2 = glm::dot(nearest, nearest);
+	float far2 = glm::dot(farthest, farthest);
+
+	// opening criterion: far enough away to count as one boid at the centre
+	// of mass. A node holding the querying boid is always opened (for theta
+	// over 1/sqrt(3) it could pass), so we never avoid ourselves.
+	glm::vec3 size = n.hi - n.lo;
+	float width = glm::max(glm::max(size.x, size.y), size.z);
+	glm::vec3 toCentre = n.sumPosition / count - p;
+	float centre2 = glm::dot(toCentre, toCentre);
+	bool distant = !containsSelf && width * width < q.theta2 * centre2;
+
+	// Each behaviour is settled here when the node is out of range, distant
+	// (then in or out by its centre of mass) or, for cohesion and alignment,
+	// wholly in range. Otherwise the node is opened for it.
+	int open = 0;
+	for (int k = 0; k < 3; k++) {
+		if (!(active & (1 << k)) || near2 >= q.radius2[k]) continue;
+		bool inside = k != 0 && far2 < q.radius2[k];
+		if (!inside && !distant) {
+			open |= 1 << k;
+			continue;
+		}
+		if (distant && centre2 >= q.radius2[k]) continue;
+
+		if (k == 0) {
+			sums.avoid -= toCentre * (count / glm::sqrt(centre2));
+			sums.numAvoid += count;
+		}
+		else if (k == 1) {
+			sums.cohesion += n.sumPosition;
+			sums.numCohesion += count;
+		}
+		else {
+			sums.alignment += n.sumVelocity - (containsSelf ? m_boids->velocity(q.self) : glm::vec3(0));
+			sums.numAlignment += count - (containsSelf ? 1 : 0);
+		}
+	}
+	if (!open) return;
+
+	if (n.firstChild != -1) {
+		for (int c = n.firstChild; c < n.firstChild + n.numChildren; c++) gather(q, c, open, sums);
+		return;
+	}
+
+	// leaf, test the boids one by one
+	for (int k = n.first; k < n.last; k++) {
+		int j = m_sorted[k];
+		glm::vec3 other = m_boids->position(j);
+		glm::vec3 d = other - p;
+		float dist2 = glm::dot(d, d);
+		if ((open & 1) && dist2 < q.radius2[0] && dist2 != 0) {
+			sums.avoid -= d / glm::sqrt(dist2);
+			sums.numAvoid++;
+		}
+		if ((open & 2) && dist2 < q.radius2[1]) {
+			sums.cohesion += other;
+			sums.numCohesion++;
+		}
+		if ((open & 4) && dist2 < q.radius2[2] && j != q.self) {
+			sums.alignment += m_boids->velocity(j);
+			sums.numAlignment++;
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// glm
+#include <glm.hpp>
+
+// project
+#include "boid_store.hpp"
+
+
+// Barnes-Hut octree for flocking over large sight radii. Every flock gets
+// its own tree, and every node keeps the summed position and velocity of
+// the boids below it. A node that is far away compared to its size
+// (size < theta * distance to its centre of mass) counts as all of its
+// boids sitting at the centre of mass, so a query touches O(log N) nodes
+// instead of every boid in the radius. theta = 0 gives the exact sums.
+class FlockTree {
+public:
+	// avoid, cohere and align sums of one boid
+	struct Sums {
+		glm::vec3 avoid		= glm::vec3(0);	// sum of directions away from the others
+		glm::vec3 cohesion	= glm::vec3(0);	// sum of positions
+		glm::vec3 alignment	= glm::vec3(0);	// sum of velocities
+		float numAvoid		= 0;
+		float numCohesion	= 0;
+		float numAlignment	= 0;
+	};
+
+private:
+	struct Node {
+		glm::vec3 lo, hi;			// bounds of the boids in the node
+		glm::vec3 sumPosition;
+		glm::vec3 sumVelocity;
+		int first, last;			// the node's boids are m_sorted[first .. last)
+		int firstChild = -1;		// children are contiguous, -1 for a leaf
+		int numChildren = 0;
+	};
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_sorted;		// boid indices, sorted by flock then Morton key
+	std::vector<int> m_rank;		// position of every prey boid in m_sorted
+	std::vector<int> m_roots;		// root node of every flock (-1 for none)
+	const BoidStore *m_boids = nullptr;
+	bool m_valid = false;
+
+	// build scratch
+	std::vector<std::pair<uint64_t, int>> m_keys;
+
+	static const int s_leaf_size = 8;
+	static const int s_max_depth = 10;	// 10 bits per axis in the keys
+
+	// fills in node (already allocated) for m_sorted[first .. last)
+	void buildNode(int node, int first, int last, int depth);
+
+	struct Query;
+	void gather(const Query &q, int node, int active, Sums &sums) const;
+
+public:
+	// drops the tree, queries fall back to the grid
+	void clear() { m_valid = false; }
+	bool valid() const { return m_valid; }
+
+	// rebuilds the trees of every flock (the prey range of the store)
+	void build(const BoidStore &boids);
+
+	// the same sums as Boid::gatherNeighbours: directions away from every
+	// flocking boid within avoidDist of prey boid i, positions of i's flock
+	// within cohesionDist (i included) and velocities of i's flock within
+	// alignmentDist (i left out)
+	Sums gather(int i, float avoidDist, float cohesionDist, float alignmentDist, float theta) const;
+
+	int numNodes() const { return int(m_nodes.size()); }
+};
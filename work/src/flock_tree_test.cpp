@@ -0,0 +1,114 @@
+// std
+#include <iostream>
+#include <vector>
+
+// glm
+#include <glm.hpp>
+
+// project
+#include "boid_random.hpp"
+#include "boid_store.hpp"
+#include "flock_tree.hpp"
+
+
+using namespace std;
+
+
+namespace {
+	int failures = 0;
+
+	void check(bool ok, const char *what, int i) {
+		if (!ok) {
+			cerr << "FAILED: " << what << " (boid " << i << ")" << endl;
+			failures++;
+		}
+	}
+
+	bool near(glm::vec3 a, glm::vec3 b) {
+		return glm::length(a - b) <= 1e-3f * glm::max(glm::length(b), 1.0f);
+	}
+
+	// the sums the grid path of Boid::gatherNeighbours gives (no wrap)
+	FlockTree::Sums bruteForce(const BoidStore &boids, int i, float avoidDist, float cohesionDist, float alignmentDist) {
+		FlockTree::Sums sums;
+		glm::vec3 p = boids.position(i);
+		for (int j = 0; j < boids.numPrey(); j++) {
+			glm::vec3 other = boids.position(j);
+			float distance = glm::distance(p, other);
+			if (distance < avoidDist && distance != 0) {
+				sums.avoid += (p - other) / distance;
+				sums.numAvoid++;
+			}
+			if (boids.flockID(i) == boids.flockID(j)) {
+				if (distance < cohesionDist) {
+					sums.cohesion += other;
+					sums.numCohesion++;
+				}
+				if (distance < alignmentDist && distance != 0) {
+					sums.alignment += boids.velocity(j);
+					sums.numAlignment++;
+				}
+			}
+		}
+		return sums;
+	}
+
+	// two flocks spread over a box of half-size 10
+	void fill(BoidStore &boids, int n) {
+		for (int i = 0; i < n; i++) {
+			BoidRandom rand(7, i);
+			boids.push_back(rand.linearRand(glm::vec3(-10), glm::vec3(10)), rand.sphericalRand(1.0f), i % 2, glm::vec3(0, 1, 0), 0);
+		}
+	}
+}
+
+
+// Checks FlockTree against brute force: exact with theta = 0, and with a
+// wide theta never counting the querying boid among the ones it avoids.
+//
+int main() {
+	BoidStore boids;
+	fill(boids, 600);
+	FlockTree tree;
+	tree.build(boids);
+
+	// theta = 0 opens every node, so the sums are the exact ones
+	for (int i = 0; i < boids.numPrey(); i += 7) {
+		FlockTree::Sums t = tree.gather(i, 2, 3, 2.5f, 0);
+		FlockTree::Sums b = bruteForce(boids, i, 2, 3, 2.5f);
+		check(t.numAvoid == b.numAvoid && t.numCohesion == b.numCohesion && t.numAlignment == b.numAlignment,
+			"theta 0 counts", i);
+		check(near(t.avoid, b.avoid) && near(t.cohesion, b.cohesion) && near(t.alignment, b.alignment),
+			"theta 0 sums", i);
+	}
+
+	// with every boid in range the counts are exact at any theta, as long as
+	// nodes holding the querying boid are never taken as distant
+	for (float theta : { 0.5f, 1.0f, 1.5f, 3.0f }) {
+		for (int i = 0; i < boids.numPrey(); i += 7) {
+			FlockTree::Sums t = tree.gather(i, 100, 100, 100, theta);
+			FlockTree::Sums b = bruteForce(boids, i, 100, 100, 100);
+			check(t.numAvoid == b.numAvoid, "high theta avoid count", i);
+			check(t.numCohesion == b.numCohesion, "high theta cohesion count", i);
+			check(t.numAlignment == b.numAlignment, "high theta alignment count", i);
+			check(near(t.cohesion, b.cohesion) && near(t.alignment, b.alignment), "high theta sums", i);
+		}
+	}
+
+	// an isolated boid next to a tight cluster avoids only the cluster
+	{
+		BoidStore pair;
+		pair.push_back(glm::vec3(0), glm::vec3(1, 0, 0), 0, glm::vec3(0, 1, 0), 0);
+		for (int i = 0; i < 20; i++) {
+			BoidRandom rand(3, i);
+			pair.push_back(glm::vec3(10, 0, 0) + rand.linearRand(glm::vec3(-0.5f), glm::vec3(0.5f)), glm::vec3(1, 0, 0), 0, glm::vec3(0, 1, 0), 0);
+		}
+		FlockTree clustered;
+		clustered.build(pair);
+		FlockTree::Sums t = clustered.gather(0, 20, 1, 1, 1.5f);
+		check(t.numAvoid == 20 && t.avoid.x < 0, "isolated boid avoids the cluster only", 0);
+	}
+
+	if (failures == 0) cout << "flock_tree_test: all passed" << endl;
+	return failures == 0 ? 0 : 1;
+}
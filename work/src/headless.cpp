@@ -0,0 +1,156 @@
+// std
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// project
+#include "cpu_features.hpp"
+#include "profiler.hpp"
+#include "simulation.hpp"
+
+
+using namespace std;
+
+
+namespace {
+	void printUsage(const char *exe) {
+		cerr << "Usage: " << exe << " [options]" << endl
+			<< "  --steps N       steps to run (default 1000)" << endl
+			<< "  --boids N       boids per flock (default 150)" << endl
+			<< "  --predators N   predators, completion only (default 1)" << endl
+			<< "  --scene NAME    core or completion (default completion)" << endl
+			<< "  --bound H       half-size of the bounding box (default 20)" << endl
+			<< "  --bounds MODE   0 = wrap, 1 = bounce, 2 = force bounce (default 2)" << endl
+			<< "  --timestep DT   seconds per step (default 1/60)" << endl
+			<< "  --skin S        neighbour list skin, 0 for no lists (default 0)" << endl
+			<< "  --reorder N     Morton reorder every N steps, 0 for never (default 0)" << endl
+			<< "  --theta T       Barnes-Hut flocking with opening angle T, 0 for off (default 0)" << endl
+			<< "  --knn K         flock with the K nearest boids, 0 for radius flocking (default 0)" << endl
+			<< "  --evade F       evade predators through a field with falloff F, 0 for off (default 0)" << endl
+			<< "  --simd LEVEL    kernel instruction set: scalar, sse2, avx2 or avx512" << endl
+			<< "                  (default the best the CPU supports)" << endl
+			<< "  --seed S        deterministic run from seed S" << endl
+			<< "  --threads N     OpenMP threads (default all)" << endl
+			<< "  --trace FILE    write the last steps as Chrome trace JSON" << endl;
+	}
+}
+
+
+// Batch runner for the flocking model. Loads a scene from the command line
+// options, runs it for a number of steps as fast as it can (no window, no
+// GL) and reports the throughput.
+// 
+int main(int argc, char **argv) {
+	Simulation sim;
+	SceneSettings settings = sim.settings();
+	int steps = 1000;
+	string scene = "completion";
+	float timestep = 1.0f / 60.0f;
+	string trace;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--help" || arg == "-h") {
+			printUsage(argv[0]);
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			cerr << "Error: missing value for " << arg << endl;
+			printUsage(argv[0]);
+			return 1;
+		}
+		const char *value = argv[++i];
+
+		if (arg == "--steps") steps = atoi(value);
+		else if (arg == "--boids") sim.setNumBoids(atoi(value));
+		else if (arg == "--predators") sim.setNumPredators(atoi(value));
+		else if (arg == "--scene") scene = value;
+		else if (arg == "--bound") settings.bound = glm::vec3(float(atof(value)));
+		else if (arg == "--bounds") settings.boundsCollision = atoi(value);
+		else if (arg == "--timestep") timestep = float(atof(value));
+		else if (arg == "--skin") {
+			settings.neighbourSkin = float(atof(value));
+			settings.neighbourLists = settings.neighbourSkin > 0;
+		}
+		else if (arg == "--reorder") settings.reorderInterval = atoi(value);
+		else if (arg == "--knn") settings.topologicalNeighbours = atoi(value);
+		else if (arg == "--simd") {
+			SimdLevel level;
+			if (!parseSimdLevel(value, level)) {
+				cerr << "Error: unknown instruction set " << value << endl;
+				printUsage(argv[0]);
+				return 1;
+			}
+			if (setSimdLevel(level) != level) {
+				cerr << "Warning: " << value << " is not supported here, using " << simdLevelName(simdLevel()) << endl;
+			}
+		}
+		else if (arg == "--theta") {
+			settings.treeTheta = float(atof(value));
+			settings.flockTree = settings.treeTheta > 0;
+		}
+		else if (arg == "--evade") {
+			settings.fieldFalloff = float(atof(value));
+			settings.predatorField = settings.fieldFalloff > 0;
+		}
+		else if (arg == "--seed") {
+			settings.deterministic = true;
+			settings.seed = unsigned(strtoul(value, nullptr, 10));
+		}
+		else if (arg == "--trace") trace = value;
+		else if (arg == "--threads") {
+#ifdef _OPENMP
+			omp_set_num_threads(glm::max(atoi(value), 1));
+#endif
+		}
+		else {
+			cerr << "Error: unknown option " << arg << endl;
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	sim.setSettings(settings);
+	if (scene == "core") sim.loadCore();
+	else if (scene == "completion") sim.loadCompletion();
+	else {
+		cerr << "Error: unknown scene " << scene << endl;
+		return 1;
+	}
+
+	Profiler::setEnabled(!trace.empty());
+	Profiler::setThreadName("simulation");
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	cout << "scene " << scene << ", " << sim.boids().size() << " boids, "
+		<< steps << " steps, " << threads << " threads, "
+		<< simdLevelName(simdLevel()) << " kernels" << endl;
+
+	// boid updates counts every boid in every step (kills change the count)
+	double updates = 0;
+	chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+	for (int i = 0; i < steps; i++) {
+		updates += double(sim.boids().size());
+		sim.update(timestep);
+	}
+	double seconds = (chrono::steady_clock::now() - start) / 1.0s;
+
+	cout << "time " << seconds << " s" << endl;
+	cout << "steps/sec " << (seconds > 0 ? steps / seconds : 0) << endl;
+	cout << "boid-updates/sec " << (seconds > 0 ? updates / seconds : 0) << endl;
+	cout << "boids remaining " << sim.boids().size() << endl;
+	cout << "neighbour list builds " << sim.neighbours().rebuilds() << endl;
+
+	if (!trace.empty() && !Profiler::writeChromeTrace(trace)) {
+		cerr << "Error: could not write " << trace << endl;
+		return 1;
+	}
+}
@@ -0,0 +1,275 @@
+// project
+#include "cpu_features.hpp"
+#include "neighbour_kernel.hpp"
+
+#ifdef BOIDS_X86
+#include <immintrin.h>
+#endif
+
+
+void sumNeighboursScalar(const NeighbourQuery &q, const CellArrays &cells, int first, int last, NeighbourSums &sums) {
+	for (int k = first; k < last; k++) {
+		glm::vec3 other(cells.x[k], cells.y[k], cells.z[k]);
+		glm::vec3 d = other - q.position;
+		if (q.periodic) {
+			d -= q.period * glm::round(d / q.period);
+			other = q.position + d;
+		}
+		float dist2 = glm::dot(d, d);
+
+		// (dist2 != 0 skips ourselves)
+		if (dist2 < q.avoidDist2 && dist2 != 0) {
+			sums.avoid -= d / glm::sqrt(dist2);
+			sums.numAvoid++;
+		}
+		if (cells.flock[k] == q.flockID) {
+			if (dist2 < q.cohesionDist2) {
+				sums.cohesion += other;
+				sums.numCohesion++;
+			}
+			if (dist2 < q.alignmentDist2 && dist2 != 0) {
+				sums.alignment += glm::vec3(cells.vx[k], cells.vy[k], cells.vz[k]);
+				sums.numAlignment++;
+			}
+		}
+	}
+}
+
+
+namespace {
+
+	// adds the lanes of the vector accumulators to sums, in lane order
+	void addLanes(const float *lanes, int width, NeighbourSums &sums) {
+		// lanes holds avoid xyz, cohesion xyz, alignment xyz, then the three counts
+		float total[12] = { 0 };
+		for (int a = 0; a < 12; a++) {
+			for (int l = 0; l < width; l++) total[a] += lanes[a * width + l];
+		}
+		sums.avoid += glm::vec3(total[0], total[1], total[2]);
+		sums.cohesion += glm::vec3(total[3], total[4], total[5]);
+		sums.alignment += glm::vec3(total[6], total[7], total[8]);
+		sums.numAvoid += total[9];
+		sums.numCohesion += total[10];
+		sums.numAlignment += total[11];
+	}
+
+
+#ifdef BOIDS_X86
+	// 4 boids at a time
+	BOIDS_TARGET("sse2")
+	void sumNeighboursSSE2(const NeighbourQuery &q, const CellArrays &cells, int first, int last, NeighbourSums &sums) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 px = _mm_set1_ps(q.position.x), py = _mm_set1_ps(q.position.y), pz = _mm_set1_ps(q.position.z);
+		const __m128 lx = _mm_set1_ps(q.period.x), ly = _mm_set1_ps(q.period.y), lz = _mm_set1_ps(q.period.z);
+		const __m128 ilx = _mm_set1_ps(1 / q.period.x), ily = _mm_set1_ps(1 / q.period.y), ilz = _mm_set1_ps(1 / q.period.z);
+		const __m128 avoid2 = _mm_set1_ps(q.avoidDist2);
+		const __m128 cohesion2 = _mm_set1_ps(q.cohesionDist2);
+		const __m128 alignment2 = _mm_set1_ps(q.alignmentDist2);
+		const __m128i flockID = _mm_set1_epi32(q.flockID);
+
+		__m128 acc[12];
+		for (__m128 &a : acc) a = zero;
+
+		int k = first;
+		for (; k + 4 <= last; k += 4) {
+			__m128 ox = _mm_loadu_ps(cells.x + k), oy = _mm_loadu_ps(cells.y + k), oz = _mm_loadu_ps(cells.z + k);
+			__m128 dx = _mm_sub_ps(ox, px), dy = _mm_sub_ps(oy, py), dz = _mm_sub_ps(oz, pz);
+			if (q.periodic) {
+				dx = _mm_sub_ps(dx, _mm_mul_ps(lx, _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(dx, ilx)))));
+				dy = _mm_sub_ps(dy, _mm_mul_ps(ly, _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(dy, ily)))));
+				dz = _mm_sub_ps(dz, _mm_mul_ps(lz, _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(dz, ilz)))));
+				ox = _mm_add_ps(px, dx);
+				oy = _mm_add_ps(py, dy);
+				oz = _mm_add_ps(pz, dz);
+			}
+			__m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			__m128i flock = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cells.flock + k));
+			__m128 notSelf = _mm_cmpneq_ps(dist2, zero);
+			__m128 sameFlock = _mm_castsi128_ps(_mm_cmpeq_epi32(flock, flockID));
+
+			__m128 avoidMask = _mm_and_ps(_mm_cmplt_ps(dist2, avoid2), notSelf);
+			__m128 cohesionMask = _mm_and_ps(_mm_cmplt_ps(dist2, cohesion2), sameFlock);
+			__m128 alignmentMask = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(dist2, alignment2), sameFlock), notSelf);
+
+			// 1 / distance, one Newton step on the estimate (masked lanes may be inf/nan)
+			__m128 r = _mm_rsqrt_ps(dist2);
+			r = _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), dist2), _mm_mul_ps(r, r))));
+			r = _mm_and_ps(r, avoidMask);
+			acc[0] = _mm_sub_ps(acc[0], _mm_mul_ps(dx, r));
+			acc[1] = _mm_sub_ps(acc[1], _mm_mul_ps(dy, r));
+			acc[2] = _mm_sub_ps(acc[2], _mm_mul_ps(dz, r));
+
+			acc[3] = _mm_add_ps(acc[3], _mm_and_ps(ox, cohesionMask));
+			acc[4] = _mm_add_ps(acc[4], _mm_and_ps(oy, cohesionMask));
+			acc[5] = _mm_add_ps(acc[5], _mm_and_ps(oz, cohesionMask));
+
+			acc[6] = _mm_add_ps(acc[6], _mm_and_ps(_mm_loadu_ps(cells.vx + k), alignmentMask));
+			acc[7] = _mm_add_ps(acc[7], _mm_and_ps(_mm_loadu_ps(cells.vy + k), alignmentMask));
+			acc[8] = _mm_add_ps(acc[8], _mm_and_ps(_mm_loadu_ps(cells.vz + k), alignmentMask));
+
+			acc[9] = _mm_add_ps(acc[9], _mm_and_ps(one, avoidMask));
+			acc[10] = _mm_add_ps(acc[10], _mm_and_ps(one, cohesionMask));
+			acc[11] = _mm_add_ps(acc[11], _mm_and_ps(one, alignmentMask));
+		}
+
+		if (k > first) {
+			float lanes[12 * 4];
+			for (int a = 0; a < 12; a++) _mm_storeu_ps(lanes + a * 4, acc[a]);
+			addLanes(lanes, 4, sums);
+		}
+		sumNeighboursScalar(q, cells, k, last, sums);
+	}
+
+
+	// 8 boids at a time
+	BOIDS_TARGET("avx2")
+	void sumNeighboursAVX2(const NeighbourQuery &q, const CellArrays &cells, int first, int last, NeighbourSums &sums) {
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 px = _mm256_set1_ps(q.position.x), py = _mm256_set1_ps(q.position.y), pz = _mm256_set1_ps(q.position.z);
+		const __m256 lx = _mm256_set1_ps(q.period.x), ly = _mm256_set1_ps(q.period.y), lz = _mm256_set1_ps(q.period.z);
+		const __m256 ilx = _mm256_set1_ps(1 / q.period.x), ily = _mm256_set1_ps(1 / q.period.y), ilz = _mm256_set1_ps(1 / q.period.z);
+		const __m256 avoid2 = _mm256_set1_ps(q.avoidDist2);
+		const __m256 cohesion2 = _mm256_set1_ps(q.cohesionDist2);
+		const __m256 alignment2 = _mm256_set1_ps(q.alignmentDist2);
+		const __m256i flockID = _mm256_set1_epi32(q.flockID);
+		const int nearest = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+		__m256 acc[12];
+		for (__m256 &a : acc) a = zero;
+
+		int k = first;
+		for (; k + 8 <= last; k += 8) {
+			__m256 ox = _mm256_loadu_ps(cells.x + k), oy = _mm256_loadu_ps(cells.y + k), oz = _mm256_loadu_ps(cells.z + k);
+			__m256 dx = _mm256_sub_ps(ox, px), dy = _mm256_sub_ps(oy, py), dz = _mm256_sub_ps(oz, pz);
+			if (q.periodic) {
+				dx = _mm256_sub_ps(dx, _mm256_mul_ps(lx, _mm256_round_ps(_mm256_mul_ps(dx, ilx), nearest)));
+				dy = _mm256_sub_ps(dy, _mm256_mul_ps(ly, _mm256_round_ps(_mm256_mul_ps(dy, ily), nearest)));
+				dz = _mm256_sub_ps(dz, _mm256_mul_ps(lz, _mm256_round_ps(_mm256_mul_ps(dz, ilz), nearest)));
+				ox = _mm256_add_ps(px, dx);
+				oy = _mm256_add_ps(py, dy);
+				oz = _mm256_add_ps(pz, dz);
+			}
+			__m256 dist2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+			__m256i flock = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells.flock + k));
+			__m256 notSelf = _mm256_cmp_ps(dist2, zero, _CMP_NEQ_OQ);
+			__m256 sameFlock = _mm256_castsi256_ps(_mm256_cmpeq_epi32(flock, flockID));
+
+			__m256 avoidMask = _mm256_and_ps(_mm256_cmp_ps(dist2, avoid2, _CMP_LT_OQ), notSelf);
+			__m256 cohesionMask = _mm256_and_ps(_mm256_cmp_ps(dist2, cohesion2, _CMP_LT_OQ), sameFlock);
+			__m256 alignmentMask = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(dist2, alignment2, _CMP_LT_OQ), sameFlock), notSelf);
+
+			// 1 / distance, one Newton step on the estimate (masked lanes may be inf/nan)
+			__m256 r = _mm256_rsqrt_ps(dist2);
+			r = _mm256_mul_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), dist2), _mm256_mul_ps(r, r))));
+			r = _mm256_and_ps(r, avoidMask);
+			acc[0] = _mm256_sub_ps(acc[0], _mm256_mul_ps(dx, r));
+			acc[1] = _mm256_sub_ps(acc[1], _mm256_mul_ps(dy, r));
+			acc[2] = _mm256_sub_ps(acc[2], _mm256_mul_ps(dz, r));
+
+			acc[3] = _mm256_add_ps(acc[3], _mm256_and_ps(ox, cohesionMask));
+			acc[4] = _mm256_add_ps(acc[4], _mm256_and_ps(oy, cohesionMask));
+			acc[5] = _mm256_add_ps(acc[5], _mm256_and_ps(oz, cohesionMask));
+
+			acc[6] = _mm256_add_ps(acc[6], _mm256_and_ps(_mm256_loadu_ps(cells.vx + k), alignmentMask));
+			acc[7] = _mm256_add_ps(acc[7], _mm256_and_ps(_mm256_loadu_ps(cells.vy + k), alignmentMask));
+			acc[8] = _mm256_add_ps(acc[8], _mm256_and_ps(_mm256_loadu_ps(cells.vz + k), alignmentMask));
+
+			acc[9] = _mm256_add_ps(acc[9], _mm256_and_ps(one, avoidMask));
+			acc[10] = _mm256_add_ps(acc[10], _mm256_and_ps(one, cohesionMask));
+			acc[11] = _mm256_add_ps(acc[11], _mm256_and_ps(one, alignmentMask));
+		}
+
+		if (k > first) {
+			float lanes[12 * 8];
+			for (int a = 0; a < 12; a++) _mm256_storeu_ps(lanes + a * 8, acc[a]);
+			addLanes(lanes, 8, sums);
+		}
+		sumNeighboursScalar(q, cells, k, last, sums);
+	}
+
+
+	// 16 boids at a time, with mask registers instead of mask vectors
+	BOIDS_TARGET("avx512f")
+	void sumNeighboursAVX512(const NeighbourQuery &q, const CellArrays &cells, int first, int last, NeighbourSums &sums) {
+		const __m512 zero = _mm512_setzero_ps();
+		const __m512 one = _mm512_set1_ps(1.0f);
+		const __m512 px = _mm512_set1_ps(q.position.x), py = _mm512_set1_ps(q.position.y), pz = _mm512_set1_ps(q.position.z);
+		const __m512 lx = _mm512_set1_ps(q.period.x), ly = _mm512_set1_ps(q.period.y), lz = _mm512_set1_ps(q.period.z);
+		const __m512 ilx = _mm512_set1_ps(1 / q.period.x), ily = _mm512_set1_ps(1 / q.period.y), ilz = _mm512_set1_ps(1 / q.period.z);
+		const __m512 avoid2 = _mm512_set1_ps(q.avoidDist2);
+		const __m512 cohesion2 = _mm512_set1_ps(q.cohesionDist2);
+		const __m512 alignment2 = _mm512_set1_ps(q.alignmentDist2);
+		const __m512i flockID = _mm512_set1_epi32(q.flockID);
+		const int nearest = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+		const __mmask16 all = 0xffff;	// (the maskz forms, the unmasked ones trip GCC's uninitialised warnings)
+
+		__m512 acc[12];
+		for (__m512 &a : acc) a = zero;
+
+		int k = first;
+		for (; k + 16 <= last; k += 16) {
+			__m512 ox = _mm512_loadu_ps(cells.x + k), oy = _mm512_loadu_ps(cells.y + k), oz = _mm512_loadu_ps(cells.z + k);
+			__m512 dx = _mm512_sub_ps(ox, px), dy = _mm512_sub_ps(oy, py), dz = _mm512_sub_ps(oz, pz);
+			if (q.periodic) {
+				dx = _mm512_sub_ps(dx, _mm512_mul_ps(lx, _mm512_maskz_roundscale_ps(all, _mm512_mul_ps(dx, ilx), nearest)));
+				dy = _mm512_sub_ps(dy, _mm512_mul_ps(ly, _mm512_maskz_roundscale_ps(all, _mm512_mul_ps(dy, ily), nearest)));
+				dz = _mm512_sub_ps(dz, _mm512_mul_ps(lz, _mm512_maskz_roundscale_ps(all, _mm512_mul_ps(dz, ilz), nearest)));
+				ox = _mm512_add_ps(px, dx);
+				oy = _mm512_add_ps(py, dy);
+				oz = _mm512_add_ps(pz, dz);
+			}
+			__m512 dist2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+
+			__m512i flock = _mm512_loadu_si512(cells.flock + k);
+			__mmask16 notSelf = _mm512_cmp_ps_mask(dist2, zero, _CMP_NEQ_OQ);
+			__mmask16 sameFlock = _mm512_cmpeq_epi32_mask(flock, flockID);
+
+			__mmask16 avoidMask = _mm512_cmp_ps_mask(dist2, avoid2, _CMP_LT_OQ) & notSelf;
+			__mmask16 cohesionMask = _mm512_cmp_ps_mask(dist2, cohesion2, _CMP_LT_OQ) & sameFlock;
+			__mmask16 alignmentMask = _mm512_cmp_ps_mask(dist2, alignment2, _CMP_LT_OQ) & sameFlock & notSelf;
+
+			// 1 / distance, one Newton step on the estimate
+			__m512 r = _mm512_maskz_rsqrt14_ps(all, dist2);
+			r = _mm512_mul_ps(r, _mm512_sub_ps(_mm512_set1_ps(1.5f), _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), dist2), _mm512_mul_ps(r, r))));
+			acc[0] = _mm512_mask_sub_ps(acc[0], avoidMask, acc[0], _mm512_mul_ps(dx, r));
+			acc[1] = _mm512_mask_sub_ps(acc[1], avoidMask, acc[1], _mm512_mul_ps(dy, r));
+			acc[2] = _mm512_mask_sub_ps(acc[2], avoidMask, acc[2], _mm512_mul_ps(dz, r));
+
+			acc[3] = _mm512_mask_add_ps(acc[3], cohesionMask, acc[3], ox);
+			acc[4] = _mm512_mask_add_ps(acc[4], cohesionMask, acc[4], oy);
+			acc[5] = _mm512_mask_add_ps(acc[5], cohesionMask, acc[5], oz);
+
+			acc[6] = _mm512_mask_add_ps(acc[6], alignmentMask, acc[6], _mm512_loadu_ps(cells.vx + k));
+			acc[7] = _mm512_mask_add_ps(acc[7], alignmentMask, acc[7], _mm512_loadu_ps(cells.vy + k));
+			acc[8] = _mm512_mask_add_ps(acc[8], alignmentMask, acc[8], _mm512_loadu_ps(cells.vz + k));
+
+			acc[9] = _mm512_mask_add_ps(acc[9], avoidMask, acc[9], one);
+			acc[10] = _mm512_mask_add_ps(acc[10], cohesionMask, acc[10], one);
+			acc[11] = _mm512_mask_add_ps(acc[11], alignmentMask, acc[11], one);
+		}
+
+		if (k > first) {
+			float lanes[12 * 16];
+			for (int a = 0; a < 12; a++) _mm512_storeu_ps(lanes + a * 16, acc[a]);
+			addLanes(lanes, 16, sums);
+		}
+		sumNeighboursScalar(q, cells, k, last, sums);
+	}
+#endif
+}
+
+
+NeighbourKernel neighbourKernel() {
+	switch (simdLevel()) {
+#ifdef BOIDS_X86
+	case SimdLevel::AVX512: return sumNeighboursAVX512;
+	case SimdLevel::AVX2: return sumNeighboursAVX2;
+	case SimdLevel::SSE2: return sumNeighboursSSE2;
+#endif
+	default: return sumNeighboursScalar;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// glm
+#include <glm.hpp>
+
+
+// Neighbour sums for avoid, cohere and align, collected in one pass
+struct NeighbourSums {
+	glm::vec3 avoid		= glm::vec3(0);
+	glm::vec3 cohesion	= glm::vec3(0);	// sum of positions
+	glm::vec3 alignment	= glm::vec3(0);	// sum of velocities
+	float numAvoid		= 0;
+	float numCohesion	= 0;
+	float numAlignment	= 0;
+};
+
+
+// Boid data laid out in grid cell order, see SpatialGrid::cellArrays
+struct CellArrays {
+	const float *x, *y, *z;
+	const float *vx, *vy, *vz;
+	const int *flock;
+};
+
+
+// One boid's side of the neighbour sums. Distances are squared.
+struct NeighbourQuery {
+	glm::vec3 position;
+	int flockID;
+	float avoidDist2;
+	float cohesionDist2;
+	float alignmentDist2;
+	bool periodic;		// wrap mode, measure to the nearest image
+	glm::vec3 period;
+};
+
+
+// Adds the boids [first, last) of the grid's cell order to sums, the
+// same sums Boid::gatherNeighbours collects. The grid only holds prey, so
+// every boid in the cells flocks:
+//  - avoid: direction away from every boid within the avoid distance (not
+//    at distance 0)
+//  - cohesion: positions of the boid's flock within the cohesion distance
+//  - alignment: velocities of the boid's flock within the alignment
+//    distance (not at distance 0)
+//
+// The SIMD variants compare squared distances with masks instead of
+// branches and take a reciprocal square root (refined by one Newton step)
+// for the avoid weights only. Their sums are added in a different order,
+// so they match the scalar kernel to about 1e-5 relative, not bit for bit.
+typedef void (*NeighbourKernel)(const NeighbourQuery &q, const CellArrays &cells, int first, int last, NeighbourSums &sums);
+
+// the variant for the current simdLevel()
+NeighbourKernel neighbourKernel();
+
+// the reference version, one boid at a time
+void sumNeighboursScalar(const NeighbourQuery &q, const CellArrays &cells, int first, int last, NeighbourSums &sums);
@@ -0,0 +1,90 @@
+// std
+#include <algorithm>
+#include <cstdint>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// project
+#include "neighbour_list.hpp"
+
+
+bool NeighbourList::needsRebuild(const BoidStore &boids, const SpatialGrid &grid, float radius, float skin) const {
+	if (!m_valid || boids.version() != m_version) return true;
+	if (radius != m_radius || skin != m_skin || grid.periodic() != m_periodic) return true;
+	if (grid.period() != m_period) return true;	// the bounds changed
+
+	// a pair can only have closed the skin if one of them moved more than half of it
+	float limit2 = (skin * 0.5f) * (skin * 0.5f);
+	int count = boids.numPrey();
+	int moved = 0;
+	#pragma omp parallel for schedule(static) reduction(max : moved)
+	for (int i = 0; i < count; i++) {
+		glm::vec3 d = boids.position(i) - m_reference[i];
+		if (glm::dot(d, d) > limit2) moved = 1;
+	}
+	return moved != 0;
+}
+
+
+void NeighbourList::build(const BoidStore &boids, const SpatialGrid &grid, float radius, float skin) {
+	int count = boids.numPrey();
+	float reach = radius + skin;
+	float reach2 = reach * reach;
+	const float *x = boids.x(), *y = boids.y(), *z = boids.z();
+
+	m_offsets.resize(count + 1);
+	m_reference.resize(count);
+
+	// Each thread gathers the lists of a contiguous run of boids into its
+	// own buffer, then the runs are packed in boid order. One grid query per
+	// boid, and the result doesn't depend on the thread count.
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	if (int(m_thread_lists.size()) < threads) m_thread_lists.resize(threads);
+
+	#pragma omp parallel num_threads(threads)
+	{
+		int t = 0, numThreads = 1;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+		numThreads = omp_get_num_threads();
+#endif
+		int first = int(int64_t(count) * t / numThreads);
+		int last = int(int64_t(count) * (t + 1) / numThreads);
+		std::vector<int> &local = m_thread_lists[t];
+		local.clear();
+
+		for (int i = first; i < last; i++) {
+			glm::vec3 p(x[i], y[i], z[i]);
+			size_t start = local.size();
+			grid.query(p, reach, [&](int j) {
+				glm::vec3 d = grid.nearestImage(p, glm::vec3(x[j], y[j], z[j])) - p;
+				if (glm::dot(d, d) < reach2) local.push_back(j);
+			});
+			m_offsets[i + 1] = int(local.size() - start);
+			m_reference[i] = p;
+		}
+
+		#pragma omp barrier
+		#pragma omp single
+		{
+			m_offsets[0] = 0;
+			for (int i = 0; i < count; i++) m_offsets[i + 1] += m_offsets[i];
+			m_neighbours.resize(m_offsets[count]);
+		}
+
+		if (first < last) std::copy(local.begin(), local.end(), m_neighbours.begin() + m_offsets[first]);
+	}
+
+	m_radius = radius;
+	m_skin = skin;
+	m_periodic = grid.periodic();
+	m_period = grid.period();
+	m_version = boids.version();
+	m_valid = true;
+	m_rebuilds++;
+}
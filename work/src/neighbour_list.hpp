@@ -0,0 +1,53 @@
+#pragma once
+
+// std
+#include <vector>
+
+// glm
+#include <glm.hpp>
+
+// project
+#include "boid_store.hpp"
+#include "spatial_grid.hpp"
+
+
+// Verlet neighbour lists. Every prey boid gets the list of prey within the
+// sight radius plus a skin margin. As long as no boid has moved more than
+// half the skin since the lists were built, every boid within the sight
+// radius is still in the list, so the lists can be reused instead of
+// querying the grid every step.
+class NeighbourList {
+private:
+	// boid i's neighbours (itself included) are m_neighbours[m_offsets[i] .. m_offsets[i + 1])
+	std::vector<int> m_offsets;
+	std::vector<int> m_neighbours;
+	std::vector<glm::vec3> m_reference;	// positions when the lists were built
+	std::vector<std::vector<int>> m_thread_lists;	// per thread scratch for build
+
+	float m_radius = 0;		// sight radius the lists answer for
+	float m_skin = 0;
+	unsigned m_version = 0;	// BoidStore::version() when built
+	bool m_periodic = false;	// built from a wrapping grid
+	glm::vec3 m_period = glm::vec3(0);	// and its period (the minimum image depends on it)
+	bool m_valid = false;
+	int m_rebuilds = 0;
+
+public:
+	// drops the lists, queries fall back to the grid
+	void clear() { m_valid = false; }
+
+	// true if the lists are stale for the given grid, sight radius and skin
+	bool needsRebuild(const BoidStore &boids, const SpatialGrid &grid, float radius, float skin) const;
+
+	// rebuilds the lists from the grid (which must be current)
+	void build(const BoidStore &boids, const SpatialGrid &grid, float radius, float skin);
+
+	// true if the lists hold every boid within radius of their owner
+	bool covers(float radius) const { return m_valid && radius <= m_radius; }
+
+	const int *begin(int i) const { return m_neighbours.data() + m_offsets[i]; }
+	const int *end(int i) const { return m_neighbours.data() + m_offsets[i + 1]; }
+
+	// number of builds so far
+	int rebuilds() const { return m_rebuilds; }
+};
@@ -0,0 +1,160 @@
+// std
+#include <algorithm>
+#include <cmath>
+
+// project
+#include "predator_field.hpp"
+
+
+void PredatorField::nodeRange(glm::vec3 p, glm::ivec3 &lo, glm::ivec3 &hi) const {
+	lo = glm::ivec3(glm::ceil((p - m_reach - m_min) / m_spacing));
+	hi = glm::ivec3(glm::floor((p + m_reach - m_min) / m_spacing));
+	if (m_periodic) {
+		// each node once, however far the radius reaches round the box
+		hi = glm::min(hi, lo + m_dims - 1);
+	}
+	else {
+		lo = glm::max(lo, glm::ivec3(0));
+		hi = glm::min(hi, m_dims - 1);
+	}
+}
+
+
+void PredatorField::build(const BoidStore &boids, int first, int last, glm::vec3 hsize, float radius, float falloff, bool periodic) {
+	// no predators (or no reach) leaves nothing to evade
+	m_valid = false;
+	if (first >= last || radius <= 0) return;
+
+	// grow the spacing so the field never exceeds s_max_dims nodes along any axis
+	glm::vec3 extent = glm::max(hsize * 2.0f, glm::vec3(1e-6f));
+	float spacing = std::max(radius / s_nodes_per_radius, std::max(std::max(extent.x, extent.y), extent.z) / (s_max_dims - 1));
+
+	glm::ivec3 oldDims = m_dims;
+	bool wasPeriodic = m_periodic;
+	m_min = -hsize;
+	m_periodic = periodic;
+	if (periodic) {
+		// whole spacings per period, each at least spacing across
+		m_dims = glm::clamp(glm::ivec3(glm::floor(extent / spacing)), glm::ivec3(1), glm::ivec3(s_max_dims));
+		m_spacing = extent / glm::vec3(m_dims);
+	}
+	else {
+		// nodes on both walls, at least two per axis to interpolate between
+		m_dims = glm::clamp(glm::ivec3(glm::ceil(extent / spacing)) + 1, glm::ivec3(2), glm::ivec3(s_max_dims));
+		m_spacing = glm::vec3(spacing);
+	}
+
+	// Only the nodes the last build splatted into need clearing, as long as
+	// the nodes are laid out the same. Otherwise start from a zeroed field.
+	size_t numNodes = size_t(m_dims.x) * m_dims.y * m_dims.z;
+	if (m_push.size() == numNodes && m_dims == oldDims && m_periodic == wasPeriodic) {
+		m_splats.swap(m_old_splats);
+		m_plane_start.swap(m_old_plane_start);
+	}
+	else {
+		m_push.assign(numNodes, glm::vec3(0));
+		m_old_splats.clear();
+		m_old_plane_start.assign(m_dims.z + 1, 0);
+	}
+
+	// widen the push to s_nodes_per_radius spacings if the cap made the
+	// nodes coarser than that (the cell diagonal is less than two spacings)
+	m_reach = std::max(radius, s_nodes_per_radius * std::max(std::max(m_spacing.x, m_spacing.y), m_spacing.z));
+
+	// Bin the predators by plane of nodes (a counting sort, so every plane
+	// keeps them in index order). Each one lands in the few planes its
+	// reach spans.
+	const float *x = boids.x(), *y = boids.y(), *z = boids.z();
+	m_plane_start.assign(m_dims.z + 1, 0);
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			for (int kz = 0; kz < m_dims.z; kz++) m_plane_start[kz + 1] += m_plane_start[kz];
+			m_splats.resize(m_plane_start[m_dims.z]);
+			m_cursor.assign(m_plane_start.begin(), m_plane_start.end() - 1);
+		}
+		for (int j = first; j < last; j++) {
+			glm::vec3 p(x[j], y[j], z[j]);
+			glm::ivec3 lo, hi;
+			nodeRange(p, lo, hi);
+			if (hi.x < lo.x || hi.y < lo.y) continue;
+			for (int nz = lo.z; nz <= hi.z; nz++) {
+				int kz = m_periodic ? wrap(nz, m_dims.z) : nz;
+				if (pass == 0) m_plane_start[kz + 1]++;
+				else m_splats[m_cursor[kz]++] = Splat{ p, glm::ivec2(lo), glm::ivec2(hi), nz };
+			}
+		}
+	}
+
+	// the push at distance r is d / R (1 - r^2 / R^2)^falloff, scaled so its
+	// peak, at r = R / sqrt(2 falloff + 1), is 1
+	float reach2 = m_reach * m_reach;
+	falloff = std::max(falloff, 0.0f);
+	float peak = 1 / std::sqrt(2 * falloff + 1);
+	float scale = 1 / (m_reach * peak * std::pow(1 - peak * peak, falloff));
+
+	// Every plane of nodes is cleared and filled by one thread, which adds
+	// its predators' pushes in index order, so the field is the same for any
+	// thread count.
+	#pragma omp parallel for schedule(static)
+	for (int kz = 0; kz < m_dims.z; kz++) {
+		for (int s = m_old_plane_start[kz]; s < m_old_plane_start[kz + 1]; s++) {
+			const Splat &splat = m_old_splats[s];
+			for (int ny = splat.lo.y; ny <= splat.hi.y; ny++) {
+				for (int nx = splat.lo.x; nx <= splat.hi.x; nx++) {
+					int ix = m_periodic ? wrap(nx, m_dims.x) : nx;
+					int iy = m_periodic ? wrap(ny, m_dims.y) : ny;
+					m_push[nodeIndex(ix, iy, kz)] = glm::vec3(0);
+				}
+			}
+		}
+
+		for (int s = m_plane_start[kz]; s < m_plane_start[kz + 1]; s++) {
+			const Splat &splat = m_splats[s];
+			for (int ny = splat.lo.y; ny <= splat.hi.y; ny++) {
+				for (int nx = splat.lo.x; nx <= splat.hi.x; nx++) {
+					glm::vec3 d = m_min + glm::vec3(nx, ny, splat.z) * m_spacing - splat.position;
+					float d2 = glm::dot(d, d);
+					if (d2 >= reach2) continue;
+
+					float strength = scale * std::pow(1 - d2 / reach2, falloff);
+					int ix = m_periodic ? wrap(nx, m_dims.x) : nx;
+					int iy = m_periodic ? wrap(ny, m_dims.y) : ny;
+					m_push[nodeIndex(ix, iy, kz)] += d * strength;
+				}
+			}
+		}
+	}
+	m_valid = true;
+}
+
+
+glm::vec3 PredatorField::sample(glm::vec3 p) const {
+	if (!m_valid) return glm::vec3(0);
+
+	// the node below p and how far p is towards the next one along each axis
+	glm::vec3 u = (p - m_min) / m_spacing;
+	glm::ivec3 i0, i1;
+	if (m_periodic) {
+		glm::vec3 cell = glm::floor(u);
+		u -= cell;
+		i0 = glm::ivec3(cell);
+		i0 = glm::ivec3(wrap(i0.x, m_dims.x), wrap(i0.y, m_dims.y), wrap(i0.z, m_dims.z));
+		i1 = glm::ivec3(wrap(i0.x + 1, m_dims.x), wrap(i0.y + 1, m_dims.y), wrap(i0.z + 1, m_dims.z));
+	}
+	else {
+		// outside the box the field is the one on the nearest wall
+		u = glm::clamp(u, glm::vec3(0), glm::vec3(m_dims - 1));
+		i0 = glm::min(glm::ivec3(u), m_dims - 2);
+		i1 = i0 + 1;
+		u -= glm::vec3(i0);
+	}
+
+	auto at = [&](int x, int y, int z) { return m_push[nodeIndex(x, y, z)]; };
+	glm::vec3 y0 = glm::mix(
+		glm::mix(at(i0.x, i0.y, i0.z), at(i1.x, i0.y, i0.z), u.x),
+		glm::mix(at(i0.x, i1.y, i0.z), at(i1.x, i1.y, i0.z), u.x), u.y);
+	glm::vec3 y1 = glm::mix(
+		glm::mix(at(i0.x, i0.y, i1.z), at(i1.x, i0.y, i1.z), u.x),
+		glm::mix(at(i0.x, i1.y, i1.z), at(i1.x, i1.y, i1.z), u.x), u.y);
+	return glm::mix(y0, y1, u.z);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// std
+#include <vector>
+
+// glm
+#include <glm.hpp>
+
+// project
+#include "boid_store.hpp"
+
+
+// Repulsion field of the predators on a coarse grid of nodes over the
+// scene bounds. Every predator splats the push of a smooth potential
+// around it into the nodes within its radius, and the prey read the summed
+// push back with trilinear interpolation. A sample is O(1) however many
+// predators there are. A build only visits the nodes within reach of the
+// predators (and clears the ones the last build touched), so for a given
+// radius it costs O(predators) plus O(planes of nodes).
+//
+// The potential is the bump (1 - r^2 / R^2)^(falloff + 1) within R of a
+// predator, and its push (minus the gradient) points straight away from the
+// predator. It grows from 0 under the predator to 1 (normalised) at
+// R / sqrt(2 falloff + 1), then fades to 0 at R. Larger falloffs put the
+// peak closer and fade the push out sooner and more gently. The push is
+// smooth everywhere, so it interpolates well between coarse nodes.
+//
+// The nodes are R / s_nodes_per_radius apart. When the box is too big for
+// that within s_max_dims nodes per axis, R is widened to s_nodes_per_radius
+// spacings instead, so a predator always reaches every node of the cell
+// around it and its push never falls between the nodes.
+class PredatorField {
+private:
+	glm::vec3 m_min = glm::vec3(0);
+	glm::vec3 m_spacing = glm::vec3(1);	// distance between nodes along each axis
+	glm::ivec3 m_dims = glm::ivec3(1);		// nodes per axis
+	float m_reach = 0;						// R, the radius widened if the nodes are capped
+
+	// Periodic (wrap mode) fields tile the box exactly, the node past the
+	// last one is the first again, and predators push across the walls.
+	bool m_periodic = false;
+	bool m_valid = false;
+
+	std::vector<glm::vec3> m_push;	// summed push at every node, x fastest
+
+	// A predator's nodes in one plane: its (unwrapped) node range in x and
+	// y, and the unwrapped z of the plane. The splats are binned by plane,
+	// plane kz's are m_splats[m_plane_start[kz] .. m_plane_start[kz + 1]).
+	struct Splat {
+		glm::vec3 position;
+		glm::ivec2 lo, hi;
+		int z;
+	};
+	std::vector<Splat> m_splats;
+	std::vector<int> m_plane_start;
+
+	// the last build's splats, the nodes the next build has to clear
+	std::vector<Splat> m_old_splats;
+	std::vector<int> m_old_plane_start;
+
+	// build scratch
+	std::vector<int> m_cursor;
+
+	// upper limit on nodes per axis, and nodes across a predator's radius
+	static const int s_max_dims = 128;
+	static const int s_nodes_per_radius = 2;
+
+	int nodeIndex(int x, int y, int z) const { return (z * m_dims.y + y) * m_dims.x + x; }
+
+	// k wrapped into [0, n)
+	static int wrap(int k, int n) {
+		k %= n;
+		return (k < 0) ? k + n : k;
+	}
+
+	// the (unwrapped) nodes within m_reach of p
+	void nodeRange(glm::vec3 p, glm::ivec3 &lo, glm::ivec3 &hi) const;
+
+public:
+	// drops the field, samples return zero
+	void clear() { m_valid = false; }
+	bool valid() const { return m_valid; }
+
+	// rebuilds the field from the predators [first, last) of boids, each
+	// reaching radius (or further, see above), on nodes over the box
+	// [-hsize, hsize]. A periodic field wraps around the box (wrap mode).
+	void build(const BoidStore &boids, int first, int last, glm::vec3 hsize, float radius, float falloff, bool periodic = false);
+
+	// the push away from the predators at p, interpolated between the
+	// nodes around it
+	glm::vec3 sample(glm::vec3 p) const;
+
+	// how far a predator's push reaches in the current field
+	float reach() const { return m_reach; }
+};
@@ -0,0 +1,98 @@
+// std
+#include <iostream>
+
+// glm
+#include <glm.hpp>
+
+// project
+#include "boid_store.hpp"
+#include "predator_field.hpp"
+
+
+using namespace std;
+
+
+namespace {
+	int failures = 0;
+
+	void check(bool ok, const char *what) {
+		if (!ok) {
+			cerr << "FAILED: " << what << endl;
+			failures++;
+		}
+	}
+
+	// the field of one predator at p, as the scene builds it
+	PredatorField oneField(glm::vec3 p, glm::vec3 hsize, float radius, bool periodic) {
+		BoidStore boids;
+		boids.push_back(p, glm::vec3(1, 0, 0), -1, glm::vec3(1, 0, 0), 1);
+		PredatorField field;
+		field.build(boids, boids.numPrey(), int(boids.size()), hsize, radius, 2.0f, periodic);
+		return field;
+	}
+}
+
+
+// Checks for PredatorField: a predator pushes nearby prey away from
+// itself, and the push never falls between the nodes, whatever the box.
+//
+int main() {
+	// the usual case, nodes well inside the radius
+	{
+		PredatorField field = oneField(glm::vec3(0.3f, -0.2f, 0.1f), glm::vec3(20), 5, false);
+		glm::vec3 push = field.sample(glm::vec3(1.3f, -0.2f, 0.1f));
+		check(field.valid(), "field builds");
+		check(push.x > 0, "push points away from the predator");
+		check(glm::length(field.sample(glm::vec3(15, 15, 15))) == 0, "no push out of reach");
+	}
+
+	// a box too big for two nodes per radius, predator at a cell centre
+	{
+		PredatorField field = oneField(glm::vec3(0), glm::vec3(100), 2, false);
+		glm::vec3 push = field.sample(glm::vec3(0.5f, 0, 0));
+		check(glm::length(push) > 0, "coarse field still pushes next to the predator");
+		check(push.x > 0, "coarse push points away from the predator");
+	}
+
+	// wrap mode pushes across the walls
+	{
+		PredatorField field = oneField(glm::vec3(19.5f, 0, 0), glm::vec3(20), 5, true);
+		glm::vec3 push = field.sample(glm::vec3(-19, 0, 0));
+		check(push.x > 0, "periodic push reaches across the wall");
+	}
+
+	// rebuilding after the predators move clears where they were
+	for (bool periodic : { false, true }) {
+		BoidStore boids;
+		boids.push_back(glm::vec3(-10, 3, 19), glm::vec3(1, 0, 0), -1, glm::vec3(1, 0, 0), 1);
+		boids.push_back(glm::vec3(4, -2, 0), glm::vec3(1, 0, 0), -1, glm::vec3(1, 0, 0), 1);
+		PredatorField field;
+		field.build(boids, 0, 2, glm::vec3(20), 5, 2.0f, periodic);
+		boids.setPosition(0, glm::vec3(8, 8, -8));
+		boids.setPosition(1, glm::vec3(4, -1, 1));
+		field.build(boids, 0, 2, glm::vec3(20), 5, 2.0f, periodic);
+
+		PredatorField fresh;
+		fresh.build(boids, 0, 2, glm::vec3(20), 5, 2.0f, periodic);
+		bool same = true;
+		for (float x = -20; x <= 20; x += 0.7f) {
+			for (float y = -20; y <= 20; y += 0.9f) {
+				for (float z = -20; z <= 20; z += 1.1f) {
+					same = same && field.sample(glm::vec3(x, y, z)) == fresh.sample(glm::vec3(x, y, z));
+				}
+			}
+		}
+		check(same, "rebuilt field matches a fresh one");
+	}
+
+	// no predators, no field
+	{
+		BoidStore boids;
+		PredatorField field;
+		field.build(boids, 0, 0, glm::vec3(20), 5, 2.0f);
+		check(!field.valid() && glm::length(field.sample(glm::vec3(0))) == 0, "empty field");
+	}
+
+	if (failures == 0) cout << "predator_field_test: all passed" << endl;
+	return failures == 0 ? 0 : 1;
+}
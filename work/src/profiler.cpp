@@ -0,0 +1,158 @@
+// std
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+// project
+#include "profiler.hpp"
+
+
+using namespace std;
+
+
+namespace {
+	const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+	// every ring ever created, rings are never freed so readers can't race
+	// a thread exiting
+	mutex rings_mutex;
+	vector<unique_ptr<ProfileRing>> rings;
+
+	thread_local ProfileRing *thread_ring = nullptr;
+}
+
+
+atomic<bool> Profiler::s_enabled{ true };
+
+
+void ProfileRing::push(const char *name, int64_t start, int64_t end) {
+	uint64_t head = m_head.load(memory_order_relaxed);
+
+	// claim the slot before touching it, so readers can tell it may be torn
+	m_claimed.store(head + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	Slot &slot = m_slots[head % s_capacity];
+	slot.name.store(name, memory_order_relaxed);
+	slot.start.store(start, memory_order_relaxed);
+	slot.end.store(end, memory_order_relaxed);
+	m_head.store(head + 1, memory_order_release);
+}
+
+
+void ProfileRing::copy(vector<ProfileEvent> &out) const {
+	uint64_t head = m_head.load(memory_order_acquire);
+	uint64_t first = head > s_capacity ? head - s_capacity : 0;
+	size_t begin = out.size();
+	for (uint64_t i = first; i < head; i++) {
+		const Slot &slot = m_slots[i % s_capacity];
+		ProfileEvent e;
+		e.name = slot.name.load(memory_order_relaxed);
+		e.start = slot.start.load(memory_order_relaxed);
+		e.end = slot.end.load(memory_order_relaxed);
+		out.push_back(e);
+	}
+
+	// drop whatever the writer claimed again while we were copying
+	atomic_thread_fence(memory_order_acquire);
+	uint64_t after = m_claimed.load(memory_order_relaxed);
+	if (after > first + s_capacity) {
+		size_t lost = size_t(min(after - s_capacity - first, head - first));
+		out.erase(out.begin() + begin, out.begin() + begin + lost);
+	}
+}
+
+
+int64_t Profiler::now() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+
+ProfileRing &Profiler::threadRing() {
+	if (!thread_ring) {
+		lock_guard<mutex> lock(rings_mutex);
+		rings.emplace_back(new ProfileRing());
+		thread_ring = rings.back().get();
+		thread_ring->threadID = int(rings.size());
+		thread_ring->threadName = "thread " + to_string(rings.size());
+	}
+	return *thread_ring;
+}
+
+
+void Profiler::record(const char *name, int64_t start, int64_t end) {
+	threadRing().push(name, start, end);
+}
+
+
+void Profiler::setThreadName(const string &name) {
+	ProfileRing &ring = threadRing();
+	lock_guard<mutex> lock(rings_mutex);
+	ring.threadName = name;
+}
+
+
+vector<Profiler::ThreadEvents> Profiler::collect() {
+	lock_guard<mutex> lock(rings_mutex);
+	vector<ThreadEvents> out(rings.size());
+	for (size_t i = 0; i < rings.size(); i++) {
+		out[i].name = rings[i]->threadName;
+		out[i].id = rings[i]->threadID;
+		rings[i]->copy(out[i].events);
+	}
+	return out;
+}
+
+
+vector<ProfileSummary> Profiler::summarize(float windowMs) {
+	int64_t since = now() - int64_t(windowMs * 1e6);
+	vector<ProfileSummary> out;
+	for (const ThreadEvents &t : collect()) {
+		size_t first = out.size();
+		for (const ProfileEvent &e : t.events) {
+			if (e.end < since) continue;
+
+			// scopes are listed in the order they first appear
+			size_t k = first;
+			while (k < out.size() && out[k].name != e.name) k++;
+			if (k == out.size()) {
+				out.emplace_back();
+				out[k].thread = t.name;
+				out[k].name = e.name;
+			}
+			float ms = (e.end - e.start) * 1e-6f;
+			out[k].count++;
+			out[k].meanMs += ms;
+			out[k].lastMs = ms;
+		}
+		for (size_t k = first; k < out.size(); k++) out[k].meanMs /= out[k].count;
+	}
+	return out;
+}
+
+
+bool Profiler::writeChromeTrace(const string &path) {
+	ofstream file(path);
+	if (!file) return false;
+
+	vector<ThreadEvents> threads = collect();
+	file << fixed << setprecision(3);
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl;
+	bool first = true;
+	for (const ThreadEvents &t : threads) {
+		file << (first ? "" : ",\n")
+			<< "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t.id
+			<< ", \"args\": {\"name\": \"" << t.name << "\"}}";
+		first = false;
+
+		// complete events, timestamps in microseconds
+		for (const ProfileEvent &e : t.events) {
+			file << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << t.id
+				<< ", \"ts\": " << e.start / 1000.0 << ", \"dur\": " << (e.end - e.start) / 1000.0 << "}";
+		}
+	}
+	file << endl << "]}" << endl;
+	return bool(file);
+}
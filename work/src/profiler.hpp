@@ -0,0 +1,105 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// One timed scope, in nanoseconds since the profiler started
+struct ProfileEvent {
+	const char *name = nullptr;
+	int64_t start = 0;
+	int64_t end = 0;
+};
+
+
+// Fixed size ring of the most recent events of one thread. Only the owning
+// thread pushes; any thread can copy it out without locking (entries that
+// get overwritten while copying are dropped, seqlock style).
+class ProfileRing {
+private:
+	struct Slot {
+		std::atomic<const char *> name{ nullptr };
+		std::atomic<int64_t> start{ 0 };
+		std::atomic<int64_t> end{ 0 };
+	};
+
+	static constexpr uint64_t s_capacity = 1 << 14;
+	std::unique_ptr<Slot[]> m_slots{ new Slot[s_capacity] };
+	std::atomic<uint64_t> m_head{ 0 };		// number of events ever pushed
+	std::atomic<uint64_t> m_claimed{ 0 };	// number of slots the writer has started on
+
+public:
+	std::string threadName;
+	int threadID = 0;
+
+	void push(const char *name, int64_t start, int64_t end);
+
+	// appends the events still in the ring, oldest first
+	void copy(std::vector<ProfileEvent> &out) const;
+};
+
+
+// Average time of one scope on one thread over a recent window
+struct ProfileSummary {
+	std::string thread;
+	const char *name = nullptr;
+	int count = 0;
+	float meanMs = 0;
+	float lastMs = 0;
+};
+
+
+// Global hot path profiler. Scopes are recorded into a ring per thread, so
+// recording never locks or allocates after a thread's first event.
+class Profiler {
+public:
+	struct ThreadEvents {
+		std::string name;
+		int id = 0;
+		std::vector<ProfileEvent> events;
+	};
+
+	static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+	static void setEnabled(bool e) { s_enabled = e; }
+
+	// nanoseconds since the profiler started
+	static int64_t now();
+
+	// names must be string literals (only the pointer is kept)
+	static void record(const char *name, int64_t start, int64_t end);
+
+	// names the calling thread in summaries and traces
+	static void setThreadName(const std::string &name);
+
+	// copies out every thread's recent events
+	static std::vector<ThreadEvents> collect();
+
+	// per thread and scope averages over the last windowMs milliseconds
+	static std::vector<ProfileSummary> summarize(float windowMs);
+
+	// writes the recent events as Chrome trace JSON (chrome://tracing, Perfetto)
+	static bool writeChromeTrace(const std::string &path);
+
+private:
+	static std::atomic<bool> s_enabled;
+	static ProfileRing &threadRing();
+};
+
+
+// Records the time between construction and destruction under name
+class ProfileScope {
+private:
+	const char *m_name;
+	int64_t m_start;
+
+public:
+	explicit ProfileScope(const char *name) : m_name(name), m_start(Profiler::enabled() ? Profiler::now() : -1) { }
+	~ProfileScope() { if (m_start >= 0) Profiler::record(m_name, m_start, Profiler::now()); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
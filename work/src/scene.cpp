@@ -1,7 +1,4 @@
 
-// std
-#include <random>
-
 // stb
 #include <stb_image.h>
 
@@ -16,6 +13,9 @@
 // project
 #include "scene.hpp"
 #include "boid.hpp"
+#include "boid_kernels.hpp"
+#include "cpu_features.hpp"
+#include "profiler.hpp"
 #include "cgra/cgra_wavefront.hpp"
 
 
@@ -63,75 +63,57 @@ Scene::Scene() {
 }
 
 
-void Scene::loadCore() {
-	//-------------------------------------------------------------
-	// [Assignment 3] (Core) :
-	// Initialize the scene with 100-300 boids in random locations
-	// inside the current bound size.
-	//-------------------------------------------------------------
-
-	m_boids.clear();
-
-	for (int i = 0; i < m_numBoids; i++) {
-		// this creates a boid with a random location in [-1, 1]^3 and random velocity (magnitude = 1)
-		m_boids.push_back(Boid(glm::linearRand(glm::vec3(-1), glm::vec3(1)), glm::sphericalRand(1.0), 0, glm::vec3(0, 1, 0), 0));
-	}
-}
-
-void Scene::loadCompletion() {
-	//-------------------------------------------------------------
-	// [Assignment 3] (Completion) :
-	// Initialize the scene with 2 different flocks of boids,
-	// 75-150 in each flock, in random locations inside the current
-	// bound size. Additionally include at least one Predator.
-	//-------------------------------------------------------------
-
-	m_boids.clear();
-
-	for (int i = 0; i < (int) m_numBoids; i++) {
-		m_boids.push_back(Boid(glm::linearRand(glm::vec3(-1), glm::vec3(1)), glm::sphericalRand(1.0), 0, glm::vec3(0, 1, 0), 0));
-		if (i % 2 == 0) {
-			m_boids.push_back(Boid(glm::linearRand(glm::vec3(-1), glm::vec3(1)), glm::sphericalRand(1.0), 0, glm::vec3(0, 1, 0), 0));
+bool Scene::syncSettings() {
+	int load = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_settings_mutex);
+		if (m_settings_changed) {
+			m_sim.setSettings(m_shared_settings);
+			m_settings_changed = false;
 		}
-		else {
-			m_boids.push_back(Boid(glm::linearRand(glm::vec3(-1), glm::vec3(1)), glm::sphericalRand(1.0), 1, glm::vec3(0, 0, 1), 0));
-		}
-		// this creates a boid with a random location in [-1, 1]^3 and random velocity (magnitude = 1)
-		
-	}
-
-	for (int i = 0; i < m_numPredators; i++) {
-		m_boids.push_back(Boid(glm::linearRand(glm::vec3(-20), glm::vec3(-20)), glm::sphericalRand(1.0), -1, glm::vec3(1, 0, 0), 1));
+		load = m_load_request;
+		m_load_request = 0;
 	}
-}
-
-
-void Scene::loadChallenge() {
-	//-------------------------------------------------------------
-	// [Assignment 3] (Challenge) :
-	// Initialize the scene with 100-300 boids in random locations
-	// inside the current bound size. Additionally add at least
-	// three spheres with a large radius inside the bounds.
-	//-------------------------------------------------------------
-
-	// YOUR CODE GOES HERE
-	// ...
 
+	if (load == 1) m_sim.loadCore();
+	else if (load == 2) m_sim.loadCompletion();
+	else if (load == 3) m_sim.loadChallenge();
+	return load != 0;
 }
 
 
-void Scene::update(float timestep) {
-	for (Boid &b : m_boids) {
-		b.calculateForces(this);
-	}
-
-	for (Boid &b : m_boids) {
-		b.update(timestep, this);
+void Scene::publishSnapshot(float interval) {
+	ProfileScope scope("publish");
+	const BoidStore &boids = m_sim.boids();
+	BoidSnapshot &snap = m_snapshots.back();
+	size_t n = boids.size();
+	snap.previous.resize(n);
+	snap.position.resize(n);
+	snap.velocity.resize(n);
+	snap.color.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		snap.previous[i] = boids.previousPosition(i);
+		snap.position[i] = boids.position(i);
+		snap.velocity[i] = boids.velocity(i);
+		snap.color[i] = boids[i].getColor();
 	}
+	snap.bound = m_sim.bound();
+	snap.time = std::chrono::steady_clock::now();
+	snap.interval = interval;
+	m_snapshots.publish();
 }
 
 
 void Scene::draw(const glm::mat4 &proj, const glm::mat4 &view) {
+	ProfileScope scope("draw");
+	const BoidSnapshot &snap = m_snapshots.read();
+
+	// how far we are between the snapshot's last two steps
+	float alpha = 1;
+	if (snap.interval > 0) {
+		float since = std::chrono::duration<float>(std::chrono::steady_clock::now() - snap.time).count();
+		alpha = glm::clamp(since / snap.interval, 0.0f, 1.0f);
+	}
 
 	// draw skymap (magically)
 	//
@@ -183,69 +165,69 @@ void Scene::draw(const glm::mat4 &proj, const glm::mat4 &view) {
 		glUniformMatrix4fv(glGetUniformLocation(m_aabb_shader, "uProjectionMatrix"), 1, false, glm::value_ptr(proj));
 		glUniformMatrix4fv(glGetUniformLocation(m_aabb_shader, "uModelViewMatrix"), 1, false, glm::value_ptr(view));
 		glUniform3fv(glGetUniformLocation(m_aabb_shader, "uColor"), 1, glm::value_ptr(glm::vec3(0.8, 0.8, 0.8)));
-		glUniform3fv(glGetUniformLocation(m_aabb_shader, "uMax"), 1, glm::value_ptr(m_bound_hsize));
-		glUniform3fv(glGetUniformLocation(m_aabb_shader, "uMin"), 1, glm::value_ptr(-m_bound_hsize));
+		glUniform3fv(glGetUniformLocation(m_aabb_shader, "uMax"), 1, glm::value_ptr(m_gui_settings.bound));
+		glUniform3fv(glGetUniformLocation(m_aabb_shader, "uMin"), 1, glm::value_ptr(-m_gui_settings.bound));
 		draw_dummy(12);
 	}
 
 
 	// draw boids
 	//
-	for (const Boid &b : m_boids) {
-
-		// get the boid direction (default to z if no velocity)
-		glm::vec3 dir = normalize(b.velocity());
-		if (dir.x != dir.x) dir = glm::vec3(0, 0, 1);
-
-		// calculate the model matrix
-		glm::mat4 model(1);
-
-		// rotate the model to point it in the direction of its velocity
-
-		// pitch rotation
-		if (dir.y != 0) {
-			float angle = -asin(dir.y);
-			model = glm::rotate(glm::mat4(1), angle, glm::vec3(1, 0, 0)) * model;
-		}
-
-		// yaw rotation
-		if (dir.x != 0 || dir.z != 0) {
-			float angle = atan2(dir.x, dir.z);
-			model = glm::rotate(glm::mat4(1), angle, glm::vec3(0, 1, 0)) * model;
-		}
-
-		// translate the model to its worldspace position
-
-		// translate by m_position
-		model = glm::translate(glm::mat4(1), b.position()) * model;
-
-		// calculate the modelview matrix
-		glm::mat4 modelview = view * model;
+	size_t count = snap.position.size();
+	m_modelviews.resize(count);
+	{
+		ProfileScope scope("transforms");
+		buildTransforms(view, snap.position.data(), snap.previous.data(), snap.velocity.data(),
+			snap.bound, alpha, m_modelviews.data(), int(count));
+	}
 
-		// load shader and variables
+	// load shader and the per frame variables once
+	GLint modelviewLoc, colorLoc;
+	{
+		ProfileScope scope("uniforms");
 		glUseProgram(m_color_shader);
 		glUniformMatrix4fv(glGetUniformLocation(m_color_shader, "uProjectionMatrix"), 1, false, glm::value_ptr(proj));
-		glUniformMatrix4fv(glGetUniformLocation(m_color_shader, "uModelViewMatrix"), 1, false, glm::value_ptr(modelview));
-		glUniform3fv(glGetUniformLocation(m_color_shader, "uColor"), 1, glm::value_ptr(b.getColor()));
+		modelviewLoc = glGetUniformLocation(m_color_shader, "uModelViewMatrix");
+		colorLoc = glGetUniformLocation(m_color_shader, "uColor");
+	}
 
-		// draw
-		m_simple_boid_mesh.draw();
+	{
+		ProfileScope scope("submit");
+		for (size_t i = 0; i < count; i++) {
+			glUniformMatrix4fv(modelviewLoc, 1, false, glm::value_ptr(m_modelviews[i]));
+			glUniform3fv(colorLoc, 1, glm::value_ptr(snap.color[i]));
+
+			// draw
+			m_simple_boid_mesh.draw();
+		}
 	}
 }
 
 
 void Scene::renderGUI() {
 
-	if (ImGui::Button("Core", ImVec2(80, 0))) { loadCore(); }
+	// loads happen on the simulation thread (see syncSettings)
+	int load = 0;
+	if (ImGui::Button("Core", ImVec2(80, 0))) { load = 1; }
 	ImGui::SameLine();
-	if (ImGui::Button("Completion", ImVec2(80, 0))) { loadCompletion(); }
+	if (ImGui::Button("Completion", ImVec2(80, 0))) { load = 2; }
 	ImGui::SameLine();
-	if (ImGui::Button("Challenge", ImVec2(80, 0))) { loadChallenge(); }
+	if (ImGui::Button("Challenge", ImVec2(80, 0))) { load = 3; }
 
 	ImGui::Checkbox("Draw Bound", &m_show_aabb);
 	ImGui::Checkbox("Draw Axis", &m_show_axis);
 	ImGui::Checkbox("Draw Skybox", &m_show_skymap);
 
+	// repeatable runs (applied on the next load)
+	// (changed is set when any of the settings widgets below edits them)
+	SceneSettings &settings = m_gui_settings;
+	bool changed = false;
+	changed |= ImGui::Checkbox("Deterministic", &settings.deterministic);
+	if (settings.deterministic) {
+		ImGui::SameLine();
+		changed |= ImGui::InputInt("Seed", (int *) &settings.seed);
+	}
+
 	//-------------------------------------------------------------
 	// [Assignment 3] :
 	// Add ImGui sliders for controlling boid parameters :
@@ -268,142 +250,74 @@ void Scene::renderGUI() {
 	// - predator chase weight
 	//-------------------------------------------------------------
 	
-	ImGui::SliderFloat3("Bound hsize", glm::value_ptr(m_bound_hsize), 0, 100.0, "%.0f");
+	changed |= ImGui::SliderFloat3("Bound hsize", glm::value_ptr(settings.bound), 0, 100.0, "%.0f");
 
-	// YOUR CODE GOES HERE
-	// ...
-	const char * bounding[] = { "Wrap", "Bounce", "Force Bounce (best)" };
-	static int boundMethod = 2;
-	if (ImGui::Combo("Boid Bounding Methods", &boundMethod, bounding, ((int)(sizeof(bounding) / sizeof(*bounding))))) {
-		setBoundWrapping(boundMethod);
+	changed |= ImGui::Checkbox("Neighbour lists", &settings.neighbourLists);
+	if (settings.neighbourLists) {
+		ImGui::SameLine();
+		changed |= ImGui::SliderFloat("Skin", &settings.neighbourSkin, 0.1f, 5, "%.1f");
 	}
+	changed |= ImGui::SliderInt("Reorder every (steps)", &settings.reorderInterval, 0, 240);
 
-	static float minVel = 9.0f;
-	if (ImGui::SliderFloat("Min Velocity", &minVel, 1, 25, "%.0f")) {
-		for (Boid &b : m_boids) {
-			b.setBoidMinVel(minVel);
-		}
+	// kernel instruction set, up to what this CPU supports
+	int level = int(simdLevel());
+	const char *levels[] = { "scalar", "sse2", "avx2", "avx512" };
+	if (ImGui::Combo("Kernels", &level, levels, int(detectSimdLevel()) + 1)) {
+		setSimdLevel(SimdLevel(level));
 	}
 
-	static float maxVel = 20.0f;
-	if (ImGui::SliderFloat("Max Velocity", &maxVel, 1, 50, "%.0f")) {
-		for (Boid &b : m_boids) {
-			b.setBoidMaxVel(maxVel);
-		}
+	changed |= ImGui::SliderInt("Nearest neighbours (0 = radius)", &settings.topologicalNeighbours, 0, SpatialGrid::s_max_neighbours);
+	changed |= ImGui::Checkbox("Barnes-Hut flocking", &settings.flockTree);
+	if (settings.flockTree) {
+		ImGui::SameLine();
+		changed |= ImGui::SliderFloat("Theta", &settings.treeTheta, 0, 1.5f, "%.2f");
 	}
-
-	static float maxAccel = 28.0f;
-	if (ImGui::SliderFloat("Max Acceleration", &maxAccel, 5, 100, "%.0f")) {
-		for (Boid &b : m_boids) {
-			b.setBoidMaxAccel(maxAccel);
-		}
-	}
-
-	static float mass = 1.0f;
-	if (ImGui::SliderFloat("Mass of Boids", &mass, 1, 5, "%.0f")) {
-		for (Boid &b : m_boids) {
-			b.setBoidMass(mass);
-		}
-	}
-
-
-	static float cohesionDist = 0.5f;
-	if (ImGui::DragFloat("Cohesion sight dist", &cohesionDist, 0.1, 0, 50)) {
-		for (Boid &b : m_boids) {
-			b.setCoherenceDist(cohesionDist);
-		}
-	}
-
-	static float avoidDist = 1.0f;
-	if (ImGui::DragFloat("Avoid sight dist", &avoidDist, 1, 01, 50)) {
-		for (Boid &b : m_boids) {
-			b.setAvoidDist(avoidDist);
-		}
+	changed |= ImGui::Checkbox("Predator field", &settings.predatorField);
+	if (settings.predatorField) {
+		ImGui::SameLine();
+		changed |= ImGui::SliderFloat("Falloff", &settings.fieldFalloff, 0.5f, 8, "%.1f");
 	}
 
-	static float alignDist = 1.0f;
-	if (ImGui::DragFloat("Align sight dist", &alignDist, 1, 0, 50)) {
-		for (Boid &b : m_boids) {
-			b.setAlignmentDist(alignDist);
-		}
-	}
-
-	static float boidSeePredDist = 1.0f;
-	if (ImGui::DragFloat("Distance boid can see predators", &boidSeePredDist, 1, 0, 50)) {
-		for (Boid &b : m_boids) {
-			b.setBoidSeePredDist(boidSeePredDist);
-		}
-	}
-
-
-	static float cohesionWeight = 0.5f;
-	if (ImGui::DragFloat("Cohesions with boids Weight", &cohesionWeight, 0.1, 0, 20)) {
-		for (Boid &b : m_boids) {
-			b.setCoherenceWeight(cohesionWeight);
-		}
-	}
-
-	static float avoidWeight = 1.0f;
-	if (ImGui::DragFloat("avoid boids Weight", &avoidWeight, 0.1, 0, 100)) {
-		for (Boid &b : m_boids) {
-			b.setAvoidWeight(avoidWeight);
-		}
-	}
-
-	static float alignWeight = 1.0f;
-	if (ImGui::DragFloat("Align with boids weight", &alignWeight, 0.1, 0, 50)) {
-		for (Boid &b : m_boids) {
-			b.setAlignmentWeight(alignWeight);
-		}
-	}
-
-	static float boidSeePredWeight = 1.0f;
-	if (ImGui::DragFloat("Evade predator Weight", &boidSeePredWeight, 0.1, 0, 40)) {
-		for (Boid &b : m_boids) {
-			b.setBoidSeePredWeight(boidSeePredWeight);
-		}
-	}
-
-
-
-
+	// YOUR CODE GOES HERE
+	// ...
+	const char * bounding[] = { "Wrap", "Bounce", "Force Bounce (best)" };
+	changed |= ImGui::Combo("Boid Bounding Methods", &settings.boundsCollision, bounding, ((int)(sizeof(bounding) / sizeof(*bounding))));
 
+	// sliders edit the shared parameter blocks directly
+	FlockParams &boid = settings.params[0];
+	FlockParams &pred = settings.params[1];
 
+	changed |= ImGui::SliderFloat("Min Velocity", &boid.minVelocity, 1, 25, "%.0f");
+	changed |= ImGui::SliderFloat("Max Velocity", &boid.maxVelocity, 1, 50, "%.0f");
+	changed |= ImGui::SliderFloat("Max Acceleration", &boid.maxAcceleration, 5, 100, "%.0f");
+	changed |= ImGui::SliderFloat("Mass of Boids", &boid.mass, 1, 5, "%.0f");
 
 
+	changed |= ImGui::DragFloat("Cohesion sight dist", &boid.cohesionDist, 0.1, 0, 50);
+	changed |= ImGui::DragFloat("Avoid sight dist", &boid.avoidDist, 1, 01, 50);
+	changed |= ImGui::DragFloat("Align sight dist", &boid.alignmentDist, 1, 0, 50);
+	changed |= ImGui::DragFloat("Distance boid can see predators", &boid.seePredatorDist, 1, 0, 50);
 
-	static float p_mass = 2.0f;
-	if (ImGui::SliderFloat("Mass of Predator Boids", &p_mass, 1, 20, "%.0f")) {
-		for (Boid &b : m_boids) {
-			b.setPredMass(p_mass);
-		}
-	}
 
-	static float p_minVel = 1.0f;
-	if (ImGui::SliderFloat("Min Predator Velocity", &p_minVel, 1, 20, "%.0f")) {
-		for (Boid &b : m_boids) {
-			b.setPredMinVel(p_minVel);
-		}
-	}
+	changed |= ImGui::DragFloat("Cohesions with boids Weight", &boid.cohereWeight, 0.1, 0, 20);
+	changed |= ImGui::DragFloat("avoid boids Weight", &boid.avoidWeight, 0.1, 0, 100);
+	changed |= ImGui::DragFloat("Align with boids weight", &boid.alignWeight, 0.1, 0, 50);
+	changed |= ImGui::DragFloat("Evade predator Weight", &boid.evadeWeight, 0.1, 0, 40);
 
-	static float p_maxVel = 18.0f;
-	if (ImGui::SliderFloat("Max Predator Velocity", &p_maxVel, 1, 50, "%.0f")) {
-		for (Boid &b : m_boids) {
-			b.setPredMaxVel(p_maxVel);
-		}
-	}
 
-	static float p_maxAccel = 125.0f;
-	if (ImGui::SliderFloat("Max Predator Acceleration", &p_maxAccel, 100, 200, "%.0f")) {
-		for (Boid &b : m_boids) {
-			b.setPredMaxAccel(p_maxAccel);
-		}
-	}
+	changed |= ImGui::SliderFloat("Mass of Predator Boids", &pred.mass, 1, 20, "%.0f");
+	changed |= ImGui::SliderFloat("Min Predator Velocity", &pred.minVelocity, 1, 20, "%.0f");
+	changed |= ImGui::SliderFloat("Max Predator Velocity", &pred.maxVelocity, 1, 50, "%.0f");
+	changed |= ImGui::SliderFloat("Max Predator Acceleration", &pred.maxAcceleration, 100, 200, "%.0f");
+	changed |= ImGui::SliderFloat("Seek force of predator", &pred.seekForce, 100, 500, "%.0f");
+	changed |= ImGui::SliderInt("Predator retarget steps", &pred.retargetSteps, 0, 240);
 
-	static float p_seekForce = 100.0f;
-	if (ImGui::SliderFloat("Seek force of predator", &p_seekForce, 100, 500, "%.0f")) {
-		for (Boid &b : m_boids) {
-			b.setPredSeekF(p_seekForce);
-		}
+	// hand edited settings over to the simulation thread
+	if (!changed && load == 0) return;
+	std::lock_guard<std::mutex> lock(m_settings_mutex);
+	if (changed) {
+		m_shared_settings = m_gui_settings;
+		m_settings_changed = true;
 	}
-}
\ No newline at end of file
+	if (load != 0) m_load_request = load;
+}
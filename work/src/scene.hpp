@@ -2,6 +2,8 @@
 #pragma once
 
 //std
+#include <chrono>
+#include <mutex>
 #include <vector>
 
 // glm
@@ -10,10 +12,23 @@
 // project
 #include "cgra/cgra_mesh.hpp"
 #include "cgra/cgra_shader.hpp"
+#include "simulation.hpp"
+#include "triple_buffer.hpp"
 
 
-// foward declare boid class
-class Boid;
+// Immutable copy of the boids published by the simulation for drawing
+struct BoidSnapshot {
+	std::vector<glm::vec3> previous;	// positions before the last step
+	std::vector<glm::vec3> position;
+	std::vector<glm::vec3> velocity;
+	std::vector<glm::vec3> color;
+	glm::vec3 bound = glm::vec3(20);
+
+	// when it was published and how long until the next one is due (wall clock)
+	std::chrono::time_point<std::chrono::steady_clock> time;
+	float interval = 0;
+};
+
 
 class Scene {
 private:
@@ -32,46 +47,45 @@ private:
 	bool m_show_axis = false;
 	bool m_show_skymap = false;
 
-	// scene data
-	glm::vec3 m_bound_hsize = glm::vec3(20);
-	std::vector<Boid> m_boids;
-	//-------------------------------------------------------------
-	// [Assignment 3] :
-	// Create variables for keeping track of the boid parameters
-	// such as min and max speed etc. These parameters can either be
-	// public, or private with getter functions.
-	//-------------------------------------------------------------
-
-	int m_numBoids = 150;
-	int m_numPredators = 1;
-	int boundsCollision = 2;	// 0 = Wrap
-								// 1 = Bounce
-								// 2 = Force Bounce
+	// the flocking model, stepped on the simulation thread
+	Simulation m_sim;
+
+	// When the simulation runs on its own thread the GUI edits
+	// m_gui_settings (main thread only) and hands them over through
+	// m_shared_settings. The simulation thread picks them up, along with
+	// any requested scene load, in syncSettings().
+	SceneSettings m_gui_settings;
+	SceneSettings m_shared_settings;
+	bool m_settings_changed = false;
+	int m_load_request = 0;		// 0 - none, 1 - core, 2 - completion, 3 - challenge
+	std::mutex m_settings_mutex;
+
+	// snapshots for drawing, written by the simulation and read by draw()
+	TripleBuffer<BoidSnapshot> m_snapshots;
+
+	// per boid model view matrices, rebuilt every draw
+	std::vector<glm::mat4> m_modelviews;
 
 public:
 
 	Scene();
 
-	// functions that load the scene
-	void loadCore();
-	void loadCompletion();
-	void loadChallenge();
+	// the simulation (only step it from the simulation thread)
+	Simulation &simulation() { return m_sim; }
+	const Simulation &simulation() const { return m_sim; }
+
+	// (simulation thread) applies settings and scene loads requested by the
+	// GUI, returns true if the scene was reloaded
+	bool syncSettings();
 
-	// called every frame, with timestep in seconds
-	void update(float timestep);
+	// (simulation thread) publishes the current boids for drawing. interval
+	// is the wall clock time until the next publish is expected.
+	void publishSnapshot(float interval);
 
-	// called every frame, with the given projection and view matrix
+	// called every frame, with the given projection and view matrix.
+	// Draws the newest snapshot, interpolated between its last two steps.
 	void draw(const glm::mat4 &proj, const glm::mat4 &view);
 
 	// called every frame (to fill out a ImGui::TreeNode)
 	void renderGUI();
-
-	// returns a const reference to the boids vector
-	std::vector<Boid> &boids() { return m_boids; }
-
-	// returns the half-size of the bounding box (centered around the origin)
-	glm::vec3 bound() const { return m_bound_hsize; }
-	
-	int wrappingType() { return boundsCollision; }
-	void setBoundWrapping(int var) { boundsCollision = var; }
 };
\ No newline at end of file
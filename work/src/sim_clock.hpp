@@ -0,0 +1,50 @@
+#pragma once
+
+// glm
+#include <glm.hpp>
+
+
+// Fixed timestep simulation clock. Frame time goes into an accumulator and
+// comes out as whole steps of timestep(), at most maxSubsteps() per frame,
+// so a slow frame can't produce one huge unstable step and the simulation
+// cost per second doesn't depend on the display rate. (The clock runs on the
+// simulation thread, the renderer times its interpolation from the snapshots
+// it is handed instead, see Scene::draw.)
+class SimClock {
+private:
+	float m_rate = 60;			// steps per simulated second
+	int m_max_substeps = 8;
+	float m_accumulator = 0;
+	int m_last_steps = 0;
+
+public:
+	float rate() const { return m_rate; }
+	float timestep() const { return 1.0f / m_rate; }
+	int maxSubsteps() const { return m_max_substeps; }
+
+	// steps taken by the last advance
+	int lastSteps() const { return m_last_steps; }
+
+	void setRate(float hz) { m_rate = glm::max(hz, 1.0f); }
+	void setMaxSubsteps(int n) { m_max_substeps = glm::max(n, 1); }
+
+	// adds dt simulated seconds and returns how many steps to run now
+	int advance(float dt) {
+		float step = timestep();
+		m_accumulator += glm::max(dt, 0.0f);
+		int steps = int(m_accumulator / step);
+		if (steps > m_max_substeps) {
+			// too far behind, drop the time we can't catch up on
+			steps = m_max_substeps;
+			m_accumulator = 0;
+		}
+		else {
+			m_accumulator -= steps * step;
+		}
+		m_last_steps = steps;
+		return steps;
+	}
+
+	// simulated seconds until the next step is due
+	float untilNextStep() const { return glm::max(timestep() - m_accumulator, 0.0f); }
+};
@@ -0,0 +1,250 @@
+// std
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// project
+#include "simulation.hpp"
+#include "boid.hpp"
+#include "boid_random.hpp"
+#include "profiler.hpp"
+
+
+unsigned Simulation::spawnSeed() const {
+	// a fresh seed every load unless we want repeatable runs
+	return m_settings.deterministic ? m_settings.seed : std::random_device()();
+}
+
+
+void Simulation::loadCore() {
+	//-------------------------------------------------------------
+	// [Assignment 3] (Core) :
+	// Initialize the scene with 100-300 boids in random locations
+	// inside the current bound size.
+	//-------------------------------------------------------------
+
+	m_boids.clear();
+	unsigned seed = spawnSeed();
+
+	for (int i = 0; i < m_numBoids; i++) {
+		// this creates a boid with a random location in [-1, 1]^3 and random velocity (magnitude = 1)
+		BoidRandom rand(seed, i);
+		m_boids.push_back(rand.linearRand(glm::vec3(-1), glm::vec3(1)), rand.sphericalRand(1.0), 0, glm::vec3(0, 1, 0), 0);
+	}
+}
+
+void Simulation::loadCompletion() {
+	//-------------------------------------------------------------
+	// [Assignment 3] (Completion) :
+	// Initialize the scene with 2 different flocks of boids,
+	// 75-150 in each flock, in random locations inside the current
+	// bound size. Additionally include at least one Predator.
+	//-------------------------------------------------------------
+
+	m_boids.clear();
+	unsigned seed = spawnSeed();
+
+	for (int i = 0; i < (int) m_numBoids; i++) {
+		// this creates a boid with a random location in [-1, 1]^3 and random velocity (magnitude = 1)
+		BoidRandom a(seed, 2 * i);
+		m_boids.push_back(a.linearRand(glm::vec3(-1), glm::vec3(1)), a.sphericalRand(1.0), 0, glm::vec3(0, 1, 0), 0);
+
+		BoidRandom b(seed, 2 * i + 1);
+		if (i % 2 == 0) {
+			m_boids.push_back(b.linearRand(glm::vec3(-1), glm::vec3(1)), b.sphericalRand(1.0), 0, glm::vec3(0, 1, 0), 0);
+		}
+		else {
+			m_boids.push_back(b.linearRand(glm::vec3(-1), glm::vec3(1)), b.sphericalRand(1.0), 1, glm::vec3(0, 0, 1), 0);
+		}
+	}
+
+	for (int i = 0; i < m_numPredators; i++) {
+		BoidRandom rand(seed, 2 * m_numBoids + i);
+		m_boids.push_back(glm::vec3(-20), rand.sphericalRand(1.0), -1, glm::vec3(1, 0, 0), 1);
+	}
+}
+
+
+void Simulation::loadChallenge() {
+	//-------------------------------------------------------------
+	// [Assignment 3] (Challenge) :
+	// Initialize the scene with 100-300 boids in random locations
+	// inside the current bound size. Additionally add at least
+	// three spheres with a large radius inside the bounds.
+	//-------------------------------------------------------------
+
+	// YOUR CODE GOES HERE
+	// ...
+
+}
+
+
+float Simulation::sightRadius() const {
+	// expanded avoid distances are left out, those queries just span more cells
+	const FlockParams &boid = m_settings.params[0];
+	if (useTree()) return boid.avoidDist;	// the grid only finds predators' prey then
+	return glm::max(glm::max(boid.cohesionDist, boid.alignmentDist), boid.avoidDist);
+}
+
+
+void Simulation::buildGrid() {
+	float cellSize = sightRadius();
+	if (topological()) {
+		// nothing queries by radius, so size the cells for about one boid
+		// each on average and the k nearest turn up within a ring or two
+		// however sparse or packed the flocks are
+		glm::vec3 box = m_settings.bound * 2.0f;
+		cellSize = std::cbrt(box.x * box.y * box.z / glm::max(float(m_boids.numPrey()), 1.0f));
+	}
+
+	// wrap mode searches across the walls
+	m_grid.build(m_boids, 0, m_boids.numPrey(), m_settings.bound, cellSize, m_settings.boundsCollision == 0);
+}
+
+
+void Simulation::update(float timestep) {
+	ProfileScope scope("update");
+	beginStep();
+	buildField();
+	calculateForces();
+	applyBounds();
+	integrate(timestep);
+	commit();
+}
+
+
+void Simulation::beginStep() {
+	ProfileScope scope("build");
+	if (m_settings.reorderInterval > 0 && ++m_steps_since_reorder >= m_settings.reorderInterval) {
+		m_steps_since_reorder = 0;
+		reorder();
+	}
+
+	m_boids.savePositions();
+	buildGrid();
+	m_commands.begin();
+
+	if (useTree()) {
+		ProfileScope treeScope("tree");
+		m_tree.build(m_boids);
+	}
+	else {
+		m_tree.clear();
+	}
+
+	if (!m_settings.neighbourLists || useTree() || topological()) {
+		m_neighbours.clear();
+	}
+	else if (m_neighbours.needsRebuild(m_boids, m_grid, sightRadius(), m_settings.neighbourSkin)) {
+		ProfileScope listScope("neighbours");
+		m_neighbours.build(m_boids, m_grid, sightRadius(), m_settings.neighbourSkin);
+	}
+}
+
+
+void Simulation::buildField() {
+	ProfileScope scope("field");
+	if (m_settings.predatorField) {
+		m_field.build(m_boids, m_boids.numPrey(), int(m_boids.size()), m_settings.bound,
+			m_settings.params[0].seePredatorDist, m_settings.fieldFalloff, m_settings.boundsCollision == 0);
+	}
+	else {
+		m_field.clear();
+	}
+}
+
+
+void Simulation::reorder() {
+	ProfileScope scope("reorder");
+	buildGrid();
+
+	// sort by cell key, ties keep their current order. The type goes in
+	// the top bit so the prey stay in front of the predators.
+	int count = int(m_boids.size());
+	m_reorder_keys.resize(count);
+	for (int i = 0; i < count; i++) {
+		uint32_t key = m_grid.mortonKey(m_boids.position(i)) | (uint32_t(m_boids.boidType(i)) << 31);
+		m_reorder_keys[i] = std::make_pair(key, i);
+	}
+	std::sort(m_reorder_keys.begin(), m_reorder_keys.end());
+
+	m_reorder_order.resize(count);
+	for (int k = 0; k < count; k++) m_reorder_order[k] = m_reorder_keys[k].second;
+	m_boids.reorder(m_reorder_order);
+}
+
+
+void Simulation::calculateForces() {
+	ProfileScope scope("forces");
+	int count = int(m_boids.size());
+
+	// Force evaluation only reads positions and velocities, and each boid
+	// only writes its own acceleration and state, so the boids can be
+	// evaluated in parallel. Kills and other structural changes are queued
+	// in m_commands and applied after integration.
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (int i = 0; i < count; i++) {
+		m_boids[i].calculateForces(this, i);
+	}
+}
+
+
+void Simulation::applyBounds() {
+	ProfileScope scope("bounds");
+	int count = int(m_boids.size());
+	BoidArrays arrays = m_boids.arrays();
+	BoidLimits lim = limits();
+	BoundsMode mode = BoundsMode(m_settings.boundsCollision);
+	BoundsKernel kernels[2] = { boundsKernel(mode, BoidType::Boid), boundsKernel(mode, BoidType::Predator) };
+	if (!kernels[0]) return;
+
+	// one kernel call per run of boids of the same type
+	#pragma omp parallel for schedule(static)
+	for (int first = 0; first < count; first += s_batch) {
+		int last = std::min(first + s_batch, count);
+		for (int i = first; i < last;) {
+			int end = m_boids.typeRunEnd(i, last);
+			kernels[m_boids.boidType(i)](arrays, lim, m_settings.bound, i, end);
+			i = end;
+		}
+	}
+}
+
+
+void Simulation::integrate(float timestep) {
+	ProfileScope scope("integrate");
+	int count = int(m_boids.size());
+	BoidArrays arrays = m_boids.arrays();
+	BoidLimits lim = limits();
+	IntegrateKernel kernels[2] = { integrateKernel(BoidType::Boid), integrateKernel(BoidType::Predator) };
+
+	#pragma omp parallel for schedule(static)
+	for (int first = 0; first < count; first += s_batch) {
+		int last = std::min(first + s_batch, count);
+		for (int i = first; i < last;) {
+			int end = m_boids.typeRunEnd(i, last);
+			kernels[m_boids.boidType(i)](arrays, lim, timestep, i, end);
+			i = end;
+		}
+	}
+}
+
+
+BoidLimits Simulation::limits() const {
+	BoidLimits lim;
+	for (int t = 0; t < 2; t++) {
+		lim.minVelocity[t] = params(t).minVelocity;
+		lim.maxVelocity[t] = params(t).maxVelocity;
+		lim.maxAcceleration[t] = params(t).maxAcceleration;
+		lim.mass[t] = params(t).mass;
+	}
+	// predators have always been checked against the normal boid max velocity
+	lim.speedCap = params(0).maxVelocity;
+	return lim;
+}
+
+
+void Simulation::commit() {
+	ProfileScope scope("commit");
+	m_commands.apply(m_boids);
+}
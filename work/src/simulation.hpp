@@ -0,0 +1,172 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// glm
+#include <glm.hpp>
+
+// project
+#include "boid_store.hpp"
+#include "command_buffer.hpp"
+#include "flock_params.hpp"
+#include "flock_tree.hpp"
+#include "neighbour_list.hpp"
+#include "predator_field.hpp"
+#include "spatial_grid.hpp"
+
+
+// Everything the GUI can change about the simulation
+struct SceneSettings {
+	// shared tuning parameters, indexed by boid type (0 - boid, 1 - predator)
+	FlockParams params[2] = { boidParams(), predatorParams() };
+
+	glm::vec3 bound = glm::vec3(20);	// half-size of the bounding box
+	int boundsCollision = 2;	// 0 = Wrap
+								// 1 = Bounce
+								// 2 = Force Bounce
+
+	// Deterministic mode spawns from a fixed seed. Every boid gets its own
+	// random stream and the step never reduces across boids in a thread
+	// dependent order, so a run is bit-identical for any thread count.
+	bool deterministic = false;
+	unsigned seed = 1;
+
+	// Verlet neighbour lists, reused until some boid moves half the skin.
+	// Off by default: at the default speeds and sight radius every boid
+	// crosses half the skin within a couple of steps, so the lists only pay
+	// off for larger sight radii or slower boids.
+	bool neighbourLists = false;
+	float neighbourSkin = 1.0f;
+
+	// steps between sorting the boid storage into Morton order of the grid
+	// cells, so neighbours sit close together in memory (0 = never)
+	int reorderInterval = 0;
+
+	// Barnes-Hut approximation of the flocking sums (see FlockTree), for
+	// sight radii that take in most of the box. Not used in wrap mode, the
+	// tree doesn't see across the walls.
+	bool flockTree = false;
+	float treeTheta = 0.5f;
+
+	// Topological flocking: every boid flocks with its k nearest flocking
+	// boids (at most SpatialGrid::s_max_neighbours) whatever their distance,
+	// instead of everything within the sight radii. Avoidance still only
+	// counts those within the avoid distance. 0 = metric (radius) flocking.
+	int topologicalNeighbours = 0;
+
+	// Predator evasion: the predators splat a repulsion field onto a coarse
+	// grid every step (see PredatorField) reaching the boids' predator sight
+	// distance, and the boids steer along it. Higher falloffs fade the push
+	// out sooner and more gently, for calmer evasion.
+	bool predatorField = false;
+	float fieldFalloff = 2.0f;
+};
+
+
+// The flocking model on its own, without any drawing. It needs no GL
+// context, so it can be driven by the Scene on the simulation thread or
+// by the headless batch runner.
+class Simulation {
+private:
+	SceneSettings m_settings;
+	BoidStore m_boids;
+	SpatialGrid m_grid;
+	NeighbourList m_neighbours;
+	FlockTree m_tree;
+	PredatorField m_field;
+
+	// Morton reordering
+	int m_steps_since_reorder = 0;
+	std::vector<std::pair<uint32_t, int>> m_reorder_keys;
+	std::vector<int> m_reorder_order;
+	void reorder();
+	CommandBuffer m_commands;
+	//-------------------------------------------------------------
+	// [Assignment 3] :
+	// Create variables for keeping track of the boid parameters
+	// such as min and max speed etc. These parameters can either be
+	// public, or private with getter functions.
+	//-------------------------------------------------------------
+
+	int m_numBoids = 150;
+	int m_numPredators = 1;
+	unsigned spawnSeed() const;
+
+	// largest sight distance of the normal boids (that the grid answers for)
+	float sightRadius() const;
+
+	// true if the flocking sums come from m_tree this step
+	bool useTree() const { return m_settings.flockTree && m_settings.boundsCollision != 0 && !topological(); }
+
+	// rebuilds m_grid from the current boid positions
+	void buildGrid();
+
+	// the parameters the batch integrate/bounds kernels need
+	BoidLimits limits() const;
+
+	// boids per task of the batch kernels
+	static constexpr int s_batch = 1024;
+
+public:
+	// functions that load the scene
+	void loadCore();
+	void loadCompletion();
+	void loadChallenge();
+
+	// called every step, with timestep in seconds
+	void update(float timestep);
+
+	// the phases of update, in order (public so they can be timed)
+	void beginStep();					// save positions, rebuild the grid and lists
+	void buildField();					// splat the predator field (when it is on)
+	void calculateForces();
+	void applyBounds();					// wrap/bounce at the box
+	void integrate(float timestep);
+	void commit();						// apply queued kills/spawns/recolours
+
+	const SceneSettings &settings() const { return m_settings; }
+	void setSettings(const SceneSettings &s) { m_settings = s; }
+
+	// boids per flock and number of predators, used by the next load
+	int numBoids() const { return m_numBoids; }
+	int numPredators() const { return m_numPredators; }
+	void setNumBoids(int n) { m_numBoids = glm::max(n, 0); }
+	void setNumPredators(int n) { m_numPredators = glm::max(n, 0); }
+
+	// returns a reference to the boid storage
+	BoidStore &boids() { return m_boids; }
+	const BoidStore &boids() const { return m_boids; }
+
+	// returns the tuning parameters for a boid type (0 - boid, 1 - predator)
+	const FlockParams &params(int boidType) const { return m_settings.params[boidType]; }
+
+	// queue for spawn/kill/recolour requests, applied at the end of update
+	// (safe to use from the parallel loops)
+	CommandBuffer &commands() { return m_commands; }
+
+	// returns the neighbour grid (rebuilt at the start of every update)
+	const SpatialGrid &grid() const { return m_grid; }
+
+	// returns the neighbour lists (checked at the start of every update)
+	const NeighbourList &neighbours() const { return m_neighbours; }
+
+	// true if boids flock with their k nearest neighbours (see SceneSettings)
+	bool topological() const { return m_settings.topologicalNeighbours > 0; }
+
+	// returns the Barnes-Hut tree (valid only while it is in use)
+	const FlockTree &tree() const { return m_tree; }
+
+	// returns the predator repulsion field (valid only while it is in use)
+	const PredatorField &field() const { return m_field; }
+
+	// returns the half-size of the bounding box (centered around the origin)
+	glm::vec3 bound() const { return m_settings.bound; }
+
+	void setDeterministic(bool d, unsigned seed) { m_settings.deterministic = d; m_settings.seed = seed; }
+
+	int wrappingType() { return m_settings.boundsCollision; }
+	void setBoundWrapping(int var) { m_settings.boundsCollision = var; }
+};
@@ -0,0 +1,150 @@
+// std
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// project
+#include "spatial_grid.hpp"
+
+
+void SpatialGrid::build(const BoidStore &boids, int begin, int end, glm::vec3 hsize, float cellSize, bool periodic) {
+	m_boids = &boids;
+
+	// grow the cells so the grid never exceeds s_max_dims along any axis
+	float extent = std::max(std::max(hsize.x, hsize.y), hsize.z) * 2;
+	float size = std::max(cellSize, extent / s_max_dims);
+	if (size <= 0) size = 1;
+
+	m_min = -hsize;
+	m_periodic = periodic;
+	m_extent = glm::max(hsize * 2.0f, glm::vec3(1e-6f));
+	if (periodic) {
+		// whole cells per period, each at least size across
+		m_dims = glm::clamp(glm::ivec3(glm::floor(m_extent / size)), glm::ivec3(1), glm::ivec3(s_max_dims));
+		m_cell_size = m_extent / glm::vec3(m_dims);
+	}
+	else {
+		m_cell_size = glm::vec3(size);
+		m_dims = glm::clamp(glm::ivec3(glm::ceil(hsize * 2.0f / size)), glm::ivec3(1), glm::ivec3(s_max_dims));
+	}
+
+	// the bounds can change between steps (GUI), so size everything every
+	// build; resize only allocates when something grows
+	int numCells = m_dims.x * m_dims.y * m_dims.z;
+	int count = end - begin;
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	m_cell_start.resize(numCells + 1);
+	m_sorted.resize(count);
+	m_boid_cell.resize(count);
+	m_counts.resize(size_t(threads) * numCells);
+	m_block_start.resize(threads + 1);
+	m_cell_x.resize(count);
+	m_cell_y.resize(count);
+	m_cell_z.resize(count);
+	m_cell_vx.resize(count);
+	m_cell_vy.resize(count);
+	m_cell_vz.resize(count);
+	m_cell_flock.resize(count);
+	// (offset so the range's first boid is entry 0)
+	const float *x = boids.x() + begin, *y = boids.y() + begin, *z = boids.z() + begin;
+	const float *vx = boids.vx() + begin, *vy = boids.vy() + begin, *vz = boids.vz() + begin;
+	const int *flock = boids.flock() + begin;
+
+	// Counting sort. Each thread histograms a contiguous run of boids, an
+	// exclusive prefix sum over (cell, thread) turns the histograms into
+	// write offsets, and each thread scatters its run. The prefix sum is
+	// split into contiguous blocks of cells too: every thread totals its
+	// block, a scan over the few block totals gives each block's start, and
+	// every thread scans its own block from there. Boids outside the
+	// bounds are clamped into the edge cells (or wrapped if periodic).
+	// Every cell ends up in index order, which keeps neighbour sums in a
+	// fixed order for any thread count.
+	#pragma omp parallel num_threads(threads)
+	{
+		int t = 0, numThreads = 1;
+#ifdef _OPENMP
+		t = omp_get_thread_num();
+		numThreads = omp_get_num_threads();
+#endif
+		int first = int(int64_t(count) * t / numThreads);
+		int last = int(int64_t(count) * (t + 1) / numThreads);
+		int *offset = m_counts.data() + size_t(t) * numCells;
+
+		std::fill(offset, offset + numCells, 0);
+		for (int i = first; i < last; i++) {
+			int c = cellIndex(cellCoord(glm::vec3(x[i], y[i], z[i])));
+			m_boid_cell[i] = c;
+			offset[c]++;
+		}
+
+		int firstCell = int(int64_t(numCells) * t / numThreads);
+		int lastCell = int(int64_t(numCells) * (t + 1) / numThreads);
+
+		#pragma omp barrier
+		int total = 0;
+		for (int u = 0; u < numThreads; u++) {
+			const int *n = m_counts.data() + size_t(u) * numCells;
+			for (int c = firstCell; c < lastCell; c++) total += n[c];
+		}
+		m_block_start[t + 1] = total;
+
+		#pragma omp barrier
+		#pragma omp single
+		{
+			m_block_start[0] = 0;
+			for (int u = 0; u < numThreads; u++) m_block_start[u + 1] += m_block_start[u];
+			m_cell_start[numCells] = m_block_start[numThreads];
+		}
+
+		int running = m_block_start[t];
+		for (int c = firstCell; c < lastCell; c++) {
+			m_cell_start[c] = running;
+			for (int u = 0; u < numThreads; u++) {
+				int &n = m_counts[size_t(u) * numCells + c];
+				int start = running;
+				running += n;
+				n = start;
+			}
+		}
+
+		#pragma omp barrier
+
+		for (int i = first; i < last; i++) {
+			m_sorted[offset[m_boid_cell[i]]++] = i;
+		}
+
+		// copy the boid data into cell order for the neighbour kernel, and
+		// turn the entries into store indices
+		#pragma omp barrier
+		#pragma omp for schedule(static)
+		for (int k = 0; k < count; k++) {
+			int i = m_sorted[k];
+			m_cell_x[k] = x[i];
+			m_cell_y[k] = y[i];
+			m_cell_z[k] = z[i];
+			m_cell_vx[k] = vx[i];
+			m_cell_vy[k] = vy[i];
+			m_cell_vz[k] = vz[i];
+			m_cell_flock[k] = flock[i];
+			m_sorted[k] = begin + i;
+		}
+	}
+}
+
+
+CellArrays SpatialGrid::cellArrays() const {
+	CellArrays a;
+	a.x = m_cell_x.data();
+	a.y = m_cell_y.data();
+	a.z = m_cell_z.data();
+	a.vx = m_cell_vx.data();
+	a.vy = m_cell_vy.data();
+	a.vz = m_cell_vz.data();
+	a.flock = m_cell_flock.data();
+	return a;
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// glm
+#include <glm.hpp>
+
+// project
+#include "boid_store.hpp"
+#include "neighbour_kernel.hpp"
+
+
+// Uniform grid over the scene bounds used to answer neighbour queries
+// without scanning every boid. It indexes one range of the BoidStore (the
+// scene's grid holds the prey) and is rebuilt once per step, with the cell
+// size taken from the largest sight radius of the boids.
+//
+// The cells are built with a parallel counting sort into a compact layout:
+// the boids of cell c are m_sorted[m_cell_start[c] .. m_cell_start[c + 1]),
+// in index order. Rebuilding reuses the arrays, so it doesn't allocate
+// unless the boid count or the number of cells grows.
+//
+// The build also copies the boid data into cell order (cellArrays()), so a
+// row of cells is one contiguous run that a vectorised kernel can stream.
+class SpatialGrid {
+private:
+	glm::vec3 m_min = glm::vec3(0);
+	glm::vec3 m_cell_size = glm::vec3(1);
+	glm::ivec3 m_dims = glm::ivec3(1);
+
+	// Periodic (wrap mode) grids tile the box exactly and treat it as a
+	// torus: cell coordinates wrap around and distances use the nearest
+	// image of the other boid (minimum image convention).
+	bool m_periodic = false;
+	glm::vec3 m_extent = glm::vec3(1);	// the period, 2 * hsize
+
+	std::vector<int> m_cell_start;	// per cell, plus one past the end
+	std::vector<int> m_sorted;		// boid indices (into the BoidStore) sorted by cell
+	const BoidStore *m_boids = nullptr;
+
+	// boid data in cell order, entry k is boid m_sorted[k]
+	std::vector<float> m_cell_x, m_cell_y, m_cell_z;
+	std::vector<float> m_cell_vx, m_cell_vy, m_cell_vz;
+	std::vector<int> m_cell_flock;
+
+	// build scratch
+	std::vector<int> m_boid_cell;	// cell of every boid in the range
+	std::vector<int> m_counts;		// per thread histograms, then write offsets
+	std::vector<int> m_block_start;	// first write offset of every thread's block of cells
+
+	// upper limit on cells per axis, stops tiny radii in a big box
+	// from allocating millions of cells
+	static const int s_max_dims = 64;
+
+	int cellIndex(glm::ivec3 c) const { return (c.z * m_dims.y + c.y) * m_dims.x + c.x; }
+
+	// wraps a cell coordinate into [0, n)
+	static int wrap(int c, int n) { c %= n; return c < 0 ? c + n : c; }
+
+	// spreads the low 10 bits of v out to every third bit
+	static uint32_t spreadBits(uint32_t v) {
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	// calls fn(first, last) for the run of cells [x, x + n) of row (y, z),
+	// split in two if it wraps around in x
+	template <typename Fn>
+	void visitRow(int x, int n, int y, int z, Fn &fn) const {
+		int first = m_cell_start[cellIndex(glm::ivec3(x, y, z))];
+		int end = glm::min(x + n, m_dims.x);
+		int last = m_cell_start[cellIndex(glm::ivec3(end - 1, y, z)) + 1];
+		if (first < last) fn(first, last);
+		if (x + n > m_dims.x) visitRow(0, x + n - m_dims.x, y, z, fn);
+	}
+
+	// Calls visit(index) for the boids around p one ring of cells at a time,
+	// outwards from p's cell, until done(reach) is true (everything not yet
+	// visited is at least reach away) or the grid runs out.
+	template <typename Visit, typename Done>
+	void searchRings(glm::vec3 p, Visit visit, Done done) const {
+		if (m_cell_start.empty()) return;
+		glm::ivec3 c = cellCoord(p);
+
+		// cell offsets to search, a periodic grid stops at half a lap each
+		// way so no cell comes up twice
+		glm::ivec3 lo = 1 - m_dims, hi = m_dims - 1;
+		if (m_periodic) {
+			lo = -((m_dims - 1) / 2);
+			hi = m_dims / 2;
+		}
+		int maxRing = glm::max(glm::max(glm::max(-lo.x, -lo.y), -lo.z), glm::max(glm::max(hi.x, hi.y), hi.z));
+		float minCell = glm::min(glm::min(m_cell_size.x, m_cell_size.y), m_cell_size.z);
+
+		for (int r = 0; r <= maxRing; r++) {
+			for (int dz = glm::max(-r, lo.z); dz <= glm::min(r, hi.z); dz++) {
+				for (int dy = glm::max(-r, lo.y); dy <= glm::min(r, hi.y); dy++) {
+					for (int dx = glm::max(-r, lo.x); dx <= glm::min(r, hi.x); dx++) {
+						// only the shell of the cube is new in this ring
+						if (glm::max(glm::max(glm::abs(dx), glm::abs(dy)), glm::abs(dz)) != r) continue;
+
+						glm::ivec3 cc = c + glm::ivec3(dx, dy, dz);
+						if (m_periodic) {
+							cc = glm::ivec3(wrap(cc.x, m_dims.x), wrap(cc.y, m_dims.y), wrap(cc.z, m_dims.z));
+						}
+						else if (glm::any(glm::lessThan(cc, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(cc, m_dims))) {
+							continue;
+						}
+
+						int cell = cellIndex(cc);
+						for (int k = m_cell_start[cell]; k < m_cell_start[cell + 1]; k++) visit(m_sorted[k]);
+					}
+				}
+			}
+
+			// everything past this ring is at least r cells away
+			if (done(r * minCell)) break;
+		}
+	}
+
+public:
+	// rebuild the grid for the boids [first, last) inside the box
+	// [-hsize, hsize]. A periodic grid wraps around the box (wrap mode).
+	void build(const BoidStore &boids, int first, int last, glm::vec3 hsize, float cellSize, bool periodic = false);
+
+	bool periodic() const { return m_periodic; }
+
+	// returns the cell coordinate containing p (clamped, or wrapped if periodic)
+	glm::ivec3 cellCoord(glm::vec3 p) const {
+		glm::ivec3 c = glm::ivec3(glm::floor((p - m_min) / m_cell_size));
+		if (m_periodic) return glm::ivec3(wrap(c.x, m_dims.x), wrap(c.y, m_dims.y), wrap(c.z, m_dims.z));
+		return glm::clamp(c, glm::ivec3(0), m_dims - 1);
+	}
+
+	// the image of q closest to p: q itself, or in a periodic grid q shifted
+	// by whole periods so it lies within half a period of p on every axis
+	glm::vec3 nearestImage(glm::vec3 p, glm::vec3 q) const {
+		if (!m_periodic) return q;
+		glm::vec3 d = q - p;
+		return p + (d - m_extent * glm::round(d / m_extent));
+	}
+
+	// Morton (Z-order) key of the cell containing p. Sorting by it keeps
+	// boids in nearby cells close together in memory.
+	uint32_t mortonKey(glm::vec3 p) const {
+		glm::ivec3 c = cellCoord(p);
+		return spreadBits(c.x) | (spreadBits(c.y) << 1) | (spreadBits(c.z) << 2);
+	}
+
+	// the boids in cell c are sortedIndex()[cellStart(c) .. cellEnd(c))
+	int cellStart(int c) const { return m_cell_start[c]; }
+	int cellEnd(int c) const { return m_cell_start[c + 1]; }
+	const int *sortedIndex() const { return m_sorted.data(); }
+
+	// positions, velocities and flocks in cell order (as of the last build)
+	CellArrays cellArrays() const;
+
+	// the period of a periodic grid (the box size)
+	glm::vec3 period() const { return m_extent; }
+
+	// calls fn(index) for every boid in the cells overlapping the sphere (p, radius).
+	// These are only candidates, the caller still has to do the distance test
+	// (against nearestImage in a periodic grid).
+	template <typename Fn>
+	void query(glm::vec3 p, float radius, Fn fn) const {
+		queryRuns(p, radius, [&](int first, int last) {
+			for (int k = first; k < last; k++) fn(m_sorted[k]);
+		});
+	}
+
+	// as query, but calls fn(first, last) for every run [first, last) of
+	// cell order (sortedIndex(), cellArrays()) holding candidates
+	template <typename Fn>
+	void queryRuns(glm::vec3 p, float radius, Fn fn) const {
+		if (m_cell_start.empty()) return;
+		if (m_periodic) {
+			// wrapped range, at most one lap per axis so no cell is visited twice
+			glm::ivec3 lo = glm::ivec3(glm::floor((p - glm::vec3(radius) - m_min) / m_cell_size));
+			glm::ivec3 hi = glm::ivec3(glm::floor((p + glm::vec3(radius) - m_min) / m_cell_size));
+			glm::ivec3 n = glm::min(hi - lo + 1, m_dims);
+			int x = wrap(lo.x, m_dims.x);
+			for (int dz = 0; dz < n.z; dz++) {
+				int z = wrap(lo.z + dz, m_dims.z);
+				for (int dy = 0; dy < n.y; dy++) {
+					visitRow(x, n.x, wrap(lo.y + dy, m_dims.y), z, fn);
+				}
+			}
+			return;
+		}
+
+		glm::ivec3 lo = cellCoord(p - glm::vec3(radius));
+		glm::ivec3 hi = cellCoord(p + glm::vec3(radius));
+		for (int z = lo.z; z <= hi.z; z++) {
+			for (int y = lo.y; y <= hi.y; y++) {
+				// a row of cells is one contiguous run of m_sorted
+				visitRow(lo.x, hi.x - lo.x + 1, y, z, fn);
+			}
+		}
+	}
+
+	// returns the index of the boid nearest to p (nearest image if periodic)
+	// for which accept(index) is true, or -1 if there is none
+	template <typename Accept>
+	int nearest(glm::vec3 p, Accept accept) const {
+		const BoidStore &boids = *m_boids;
+		int best = -1;
+		float bestDist2 = 0;
+		searchRings(p, [&](int i) {
+			if (!accept(i)) return;
+			glm::vec3 d = nearestImage(p, boids.position(i)) - p;
+			float dist2 = glm::dot(d, d);
+			if (best == -1 || dist2 < bestDist2) {
+				best = i;
+				bestDist2 = dist2;
+			}
+		}, [&](float reach) { return best != -1 && bestDist2 <= reach * reach; });
+		return best;
+	}
+
+	// most boids nearestK will return
+	static const int s_max_neighbours = 32;
+
+	// writes the indices of the (at most s_max_neighbours) k boids nearest
+	// to p for which accept(index) is true to out, nearest first, and
+	// returns how many it found. Keeps the best k so far in a bounded
+	// max-heap, so the cost doesn't grow with the density.
+	template <typename Accept>
+	int nearestK(glm::vec3 p, int k, Accept accept, int *out) const {
+		const BoidStore &boids = *m_boids;
+		k = glm::min(k, s_max_neighbours);
+		if (k <= 0) return 0;
+
+		// (distance squared, index) pairs, ties go to the lower index
+		std::pair<float, int> heap[s_max_neighbours];
+		int count = 0;
+		searchRings(p, [&](int i) {
+			if (!accept(i)) return;
+			glm::vec3 d = nearestImage(p, boids.position(i)) - p;
+			std::pair<float, int> entry(glm::dot(d, d), i);
+			if (count < k) {
+				heap[count++] = entry;
+				std::push_heap(heap, heap + count);
+			}
+			else if (entry < heap[0]) {
+				std::pop_heap(heap, heap + count);
+				heap[count - 1] = entry;
+				std::push_heap(heap, heap + count);
+			}
+		}, [&](float reach) { return count == k && heap[0].first <= reach * reach; });
+
+		std::sort_heap(heap, heap + count);
+		for (int n = 0; n < count; n++) out[n] = heap[n].second;
+		return count;
+	}
+};
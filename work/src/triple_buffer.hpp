@@ -0,0 +1,42 @@
+#pragma once
+
+// std
+#include <atomic>
+
+
+// Lock-free single producer, single consumer triple buffer. The writer
+// fills back() and publish()es it, the reader gets the newest published
+// value from read(). Neither side ever waits for the other, and the
+// reader never sees a half written value.
+template <typename T>
+class TripleBuffer {
+private:
+	T m_buffers[3];
+
+	// index of the buffer in the middle, plus s_fresh if the writer has
+	// published it since the reader last looked
+	std::atomic<int> m_middle { 1 };
+	int m_back = 0;		// writer only
+	int m_front = 2;	// reader only
+
+	static const int s_fresh = 4;
+
+public:
+	// buffer for the writer to fill
+	T &back() { return m_buffers[m_back]; }
+
+	// hands the back buffer to the reader and takes the middle one back
+	void publish() {
+		int old = m_middle.exchange(m_back | s_fresh, std::memory_order_acq_rel);
+		m_back = old & ~s_fresh;
+	}
+
+	// newest published value (the same one again if nothing new was published)
+	const T &read() {
+		if (m_middle.load(std::memory_order_acquire) & s_fresh) {
+			int old = m_middle.exchange(m_front, std::memory_order_acq_rel);
+			m_front = old & ~s_fresh;
+		}
+		return m_buffers[m_front];
+	}
+};